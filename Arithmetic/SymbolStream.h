@@ -2,15 +2,16 @@
 #define __SYMBOL_STREAM_H__
 
 #include <cstdint>
+#include <span>
 #include <vector>
 
 class BitStream {
-    const std::vector<uint8_t> &buf;
+    std::span<const uint8_t> buf;
     uint64_t idx;
     int8_t bidx;
 
 public:
-    BitStream(const std::vector<uint8_t> &buf) : buf(buf), idx(0), bidx(7) {}
+    BitStream(std::span<const uint8_t> buf) : buf(buf), idx(0), bidx(7) {}
 
     bool next() {
         if (bidx == -1) [[unlikely]] {
@@ -32,7 +33,7 @@ class SymbolStream {
     uint64_t stride;
 
 public:
-    SymbolStream(const std::vector<uint8_t> &buf, uint64_t stride) : bs(buf), stride(stride) {}
+    SymbolStream(std::span<const uint8_t> buf, uint64_t stride) : bs(buf), stride(stride) {}
 
     SymbolType next() {
         SymbolType symbol = 0;
@@ -61,7 +62,7 @@ class BufferedSymbolStream {
     std::vector<SymbolType> symbols;
 
 public:
-    BufferedSymbolStream(const std::vector<uint8_t> &buf, uint64_t stride, uint64_t size) : ss(buf, stride), size(size) {}
+    BufferedSymbolStream(std::span<const uint8_t> buf, uint64_t stride, uint64_t size) : ss(buf, stride), size(size) {}
 
     std::vector<SymbolType> next() {
         SymbolType symbol = ss.next();
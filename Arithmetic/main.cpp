@@ -1,10 +1,12 @@
 #include <chrono>
 #include <cstdlib>
-#include <fstream>
 #include <iostream>
+#include <span>
+#include <string>
 #include <vector>
 
 #include "ACEncoder.h"
+#include "MappedFile.h"
 #include "ProbabilityModel.h"
 #include "SymbolStream.h"
 
@@ -47,7 +49,7 @@ void show_exercise_step() {
 }
 
 template <typename SymbolType, typename StorageType, uint64_t stride, uint64_t order, uint64_t nsymbols, uint64_t word_length>
-void run_all_test(const std::vector<uint8_t> &sequence) {
+void run_all_test(std::span<const uint8_t> sequence) {
     BufferedSymbolStream<SymbolType> fixed_bss(sequence, stride, 1);
     BufferedSymbolStream<SymbolType> ppm_bss(sequence, stride, order+1);
 
@@ -188,46 +190,43 @@ void test_random_sequence() {
 }
 
 template <uint64_t stride, uint64_t order>
-void test_alexnet() {
-    std::fstream f{"./alexnet.pth", std::ios::in|std::ios::binary};
-
-    if (f.fail()) throw "./alexnet path not found";
-
-    std::vector<uint8_t> seq = {std::istreambuf_iterator<char>(f), {}};
-
+void test_alexnet(std::span<const uint8_t> seq) {
     std::cout << "Using \'alexnet\' with ";
     run_all_test<uint64_t, uint64_t, stride, order, 1ULL << stride, sizeof (uint64_t)*8 - 1>(seq);
 }
 
 template <uint64_t stride, uint64_t max_order>
-void test_alexnet_stride() {
+void test_alexnet_stride(std::span<const uint8_t> seq) {
     if constexpr (max_order >= 0) {
-        test_alexnet<stride, 0>();
+        test_alexnet<stride, 0>(seq);
         std::cout << std::endl;
     }
 
     if constexpr (max_order >= 1) {
-        test_alexnet<stride, 1>();
+        test_alexnet<stride, 1>(seq);
         std::cout << std::endl;
     }
 
     if constexpr (max_order >= 2) {
-        test_alexnet<stride, 2>();
+        test_alexnet<stride, 2>(seq);
         std::cout << std::endl;
     }
 
     if constexpr (max_order >= 3) {
-        test_alexnet<stride, 3>();
+        test_alexnet<stride, 3>(seq);
         std::cout << std::endl;
     }
 
     if constexpr (max_order >= 4) {
-        test_alexnet<stride, 4>();
+        test_alexnet<stride, 4>(seq);
         std::cout << std::endl;
     }
 }
 
-int main() {
+int main(int argc, char **argv) {
+    std::string path = argc > 1 ? argv[1] : "./alexnet.pth";
+    MappedFile f{path};
+
     show_exercise_step();
     std::cout << std::endl;
 
@@ -240,12 +239,16 @@ int main() {
     test_repeated_sequence();
     std::cout << std::endl;
 
-    test_alexnet_stride<1, 4>();
-    test_alexnet_stride<2, 4>();
-    test_alexnet_stride<4, 4>();
-    test_alexnet_stride<8, 4>();
-    test_alexnet_stride<16, 3>();
-    test_alexnet_stride<32, 2>();
+    if (f.fail()) throw path + " not found";
+
+    std::span<const uint8_t> seq = f.span();
+
+    test_alexnet_stride<1, 4>(seq);
+    test_alexnet_stride<2, 4>(seq);
+    test_alexnet_stride<4, 4>(seq);
+    test_alexnet_stride<8, 4>(seq);
+    test_alexnet_stride<16, 3>(seq);
+    test_alexnet_stride<32, 2>(seq);
 
     return 0;
 }
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <span>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -15,8 +16,10 @@
 #include "Block.h"
 #include "Frequency.h"
 #include "Node.h"
+#include "VitterTree.h"
 
-template <typename KeyType, typename ValueType, bool progress=false, bool debug=false, bool block_opt=true>
+// vitter replaces FGK sibling swapping with Vitter's Algorithm Lambda (VitterTree)
+template <typename KeyType, typename ValueType, bool progress=false, bool debug=false, bool block_opt=true, bool vitter=false>
 class AdaptiveHuffman {
     AdaptiveNode<KeyType, ValueType> *root;
     AdaptiveNode<KeyType, ValueType> *NTY;
@@ -25,10 +28,12 @@ class AdaptiveHuffman {
     BlockRecorder<KeyType, ValueType> block;
     Frequency<KeyType, ValueType> len_count;
     Frequency<KeyType, ValueType> freq;
+    VitterTree<KeyType, ValueType> tree;
 
     uint64_t stride;
     KeyType next_id;
     uint64_t encoded_size;
+    uint64_t nmoves;
     std::chrono::duration<double> elapsed_time;
 
     // nalpha = 2^e + r
@@ -36,8 +41,9 @@ class AdaptiveHuffman {
     const uint64_t r;
 
 public:
-    AdaptiveHuffman(const std::vector<uint8_t> &buf, uint64_t stride, KeyType nalpha, uint64_t e, uint64_t r=0) :
-    root(nullptr), len_count(nalpha), freq(nalpha), stride(stride), next_id(nalpha - KeyType{1} + nalpha), encoded_size(0), e(e), r(r) {
+    AdaptiveHuffman(std::span<const uint8_t> buf, uint64_t stride, KeyType nalpha, uint64_t e, uint64_t r=0) :
+    root(nullptr), len_count(nalpha), freq(nalpha), tree(vitter ? 2 * std::min<KeyType>(nalpha, (buf.size() * 8 + stride - 1) / stride) + 1 : 0),
+    stride(stride), next_id(nalpha - KeyType{1} + nalpha), encoded_size(0), nmoves(0), e(e), r(r) {
         root = NTY = gen_node();
 
         if constexpr (sizeof (KeyType) >= sizeof (uint64_t)) {
@@ -144,6 +150,7 @@ public:
         }
 
         std::swap(node1->id, node2->id);
+        nmoves++;
 
         if (node1->parent->left == node1) {
             if (node2->parent->left == node2) {
@@ -254,27 +261,18 @@ public:
         }
     }
 
-    void build_coding_table(const std::vector<uint8_t> &buf) {
-        AlphabetStream<KeyType> data{buf, stride};
+    void build_coding_table(std::span<const uint8_t> buf) {
         uint64_t cnt = 0;
 
-        while (!data.empty()) {
-            KeyType alpha = data.next();
-
+        for_each_alphabet<KeyType>(buf, stride, [&](KeyType alpha) {
             if constexpr (progress) {
                 if (cnt++ % 1145 == 919) [[unlikely]] {
                     std::printf("\rProgress: %.2f%%", (double)cnt / ((buf.size() * 8.0) / stride) * 100);
                 }
             }
 
-            auto it = node_list.find(alpha);
-
-            if constexpr (debug) {
-                std::cout << (char)(alpha + 'a') << ": ";
-            }
-
-            if (it == node_list.end()) {
-                ValueType len = get_code_length(NTY) + get_NTY_code_length(alpha);
+            if constexpr (vitter) {
+                ValueType len = tree.contains(alpha) ? tree.get_code_length(alpha) : tree.get_NTY_code_length() + get_NTY_code_length(alpha);
 
                 len_count.count(alpha, len, 1);
                 freq.count(alpha);
@@ -282,29 +280,51 @@ public:
                 encoded_size += len;
 
                 if constexpr (debug) {
-                    std::cout <<  get_code(NTY) + get_NTY_code(alpha) << ", len=" << get_code_length(NTY) + get_NTY_code_length(alpha) << std::endl;
+                    std::cout << (char)(alpha + 'a') << ": len=" << len << std::endl;
                 }
+
+                tree.update(alpha);
             }
             else {
-                ValueType len = get_code_length(it->second);
+                auto it = node_list.find(alpha);
 
-                len_count.count(alpha, len, 1);
-                freq.count(alpha);
+                if constexpr (debug) {
+                    std::cout << (char)(alpha + 'a') << ": ";
+                }
 
-                encoded_size += len;
+                if (it == node_list.end()) {
+                    ValueType len = get_code_length(NTY) + get_NTY_code_length(alpha);
 
-                if constexpr (debug) {
-                    std::cout << get_code(it->second) << ", len=" << get_code_length(it->second) << std::endl;
+                    len_count.count(alpha, len, 1);
+                    freq.count(alpha);
+
+                    encoded_size += len;
+
+                    if constexpr (debug) {
+                        std::cout <<  get_code(NTY) + get_NTY_code(alpha) << ", len=" << get_code_length(NTY) + get_NTY_code_length(alpha) << std::endl;
+                    }
                 }
-            }
+                else {
+                    ValueType len = get_code_length(it->second);
+
+                    len_count.count(alpha, len, 1);
+                    freq.count(alpha);
 
-            update(alpha);
+                    encoded_size += len;
 
-            if constexpr (debug) {
-                dump_tree(root);
-                std::cout << std::endl;
+                    if constexpr (debug) {
+                        std::cout << get_code(it->second) << ", len=" << get_code_length(it->second) << std::endl;
+                    }
+                }
+
+                update(alpha);
+
+                if constexpr (debug) {
+                    dump_tree(root);
+                    std::cout << std::endl;
+                }
             }
-        }
+        });
 
         if constexpr (progress) {
             std::cout << "\r";
@@ -327,6 +347,16 @@ public:
         return freq.count_occurrence();
     }
 
+    // sibling swaps for FGK, leaf interchanges and slides for Vitter
+    uint64_t get_moves() const {
+        if constexpr (vitter) {
+            return tree.count_moves();
+        }
+        else {
+            return nmoves;
+        }
+    }
+
     void dump() {
         auto n  = get_nonzeros();
         auto o  = freq.count_occurrence();
@@ -1,44 +1,161 @@
 #ifndef __ALPHABET_STREAM_H__
 #define __ALPHABET_STREAM_H__
 
+#include <bit>
 #include <cstdint>
-#include <vector>
+#include <cstring>
+#include <span>
+#include <type_traits>
 
+#include "BitReader.h"
 #include "BitStream.h"
 
-template <typename KeyType>
+template <typename KeyType, bool word_read=true>
 class AlphabetStream {
     BitStream bit_stream;
+    BitReader reader;
     uint64_t stride;
 
 public:
-    AlphabetStream(const std::vector<uint8_t> &, uint64_t);
+    AlphabetStream(std::span<const uint8_t>, uint64_t);
     KeyType next();
     bool empty() const;
 };
 
-template <typename KeyType>
-inline AlphabetStream<KeyType>::AlphabetStream(const std::vector<uint8_t> &buf, uint64_t stride) : bit_stream(buf), stride(stride) {}
+template <typename KeyType, bool word_read>
+inline AlphabetStream<KeyType, word_read>::AlphabetStream(std::span<const uint8_t> buf, uint64_t stride) : bit_stream(buf), reader(buf), stride(stride) {}
 
-template <typename KeyType>
-inline KeyType AlphabetStream<KeyType>::next() {
-    KeyType alphabet = 0;
+template <typename KeyType, bool word_read>
+inline KeyType AlphabetStream<KeyType, word_read>::next() {
+    if constexpr (word_read) {
+        if (stride <= 56) [[likely]] {
+            return reader.read(stride);
+        }
+
+        KeyType alphabet = 0;
+        uint64_t left = stride;
+
+        // 57 to 127-bit symbols take two or three reads
+        if constexpr (sizeof (KeyType) * 8 > 56) {
+            while (left > 56) {
+                alphabet = (alphabet << 56) | reader.read(56);
+                left -= 56;
+            }
+        }
+
+        return (alphabet << left) | reader.read(left);
+    }
+    else {
+        KeyType alphabet = 0;
+
+        for (uint64_t i = stride; i > 0; i--) {
+            if (bit_stream.empty()) [[unlikely]] {
+                return alphabet << i;
+            }
 
-    for (uint64_t i = stride; i > 0; i--) {
-        if (bit_stream.empty()) [[unlikely]] {
-            return alphabet << i;
+            alphabet <<= 1;
+            alphabet |= bit_stream.next();
         }
 
-        alphabet <<= 1;
-        alphabet |= bit_stream.next();
+        return alphabet;
+    }
+}
+
+template <typename KeyType, bool word_read>
+inline bool AlphabetStream<KeyType, word_read>::empty() const {
+    if constexpr (word_read) {
+        return reader.empty();
+    }
+    else {
+        return bit_stream.empty();
+    }
+}
+
+// Byte-aligned symbols are loaded straight from memory as big-endian words
+template <typename KeyType, uint64_t stride>
+class AlignedAlphabetStream {
+    static_assert(stride == 8 || stride == 16 || stride == 32 || stride == 64, "stride must be byte-aligned");
+
+    using WordType = std::conditional_t<stride == 8, uint8_t,
+                     std::conditional_t<stride == 16, uint16_t,
+                     std::conditional_t<stride == 32, uint32_t, uint64_t>>>;
+
+    std::span<const uint8_t> buf;
+    uint64_t idx;
+
+public:
+    AlignedAlphabetStream(std::span<const uint8_t>);
+    KeyType next();
+    bool empty() const;
+};
+
+template <typename KeyType, uint64_t stride>
+inline AlignedAlphabetStream<KeyType, stride>::AlignedAlphabetStream(std::span<const uint8_t> buf) : buf(buf), idx(0) {}
+
+template <typename KeyType, uint64_t stride>
+inline KeyType AlignedAlphabetStream<KeyType, stride>::next() {
+    WordType word = 0;
+
+    if (idx + sizeof (WordType) <= buf.size()) [[likely]] {
+        std::memcpy(&word, buf.data() + idx, sizeof (WordType));
+
+        if constexpr (std::endian::native == std::endian::little) {
+            if constexpr (stride == 16) word = __builtin_bswap16(word);
+            if constexpr (stride == 32) word = __builtin_bswap32(word);
+            if constexpr (stride == 64) word = __builtin_bswap64(word);
+        }
     }
+    else {
+        // the last symbol is zero-padded
+        for (uint64_t i = 0; i < sizeof (WordType); i++) {
+            word = (uint64_t)word << 8 | (idx + i < buf.size() ? buf[idx + i] : 0);
+        }
+    }
+
+    idx += sizeof (WordType);
 
-    return alphabet;
+    return word;
 }
 
-template <typename KeyType>
-inline bool AlphabetStream<KeyType>::empty() const {
-    return bit_stream.empty();
+template <typename KeyType, uint64_t stride>
+inline bool AlignedAlphabetStream<KeyType, stride>::empty() const {
+    return idx >= buf.size();
+}
+
+// Calls func on every symbol of buf, byte-aligned strides take the AlignedAlphabetStream path
+template <typename KeyType, typename Func>
+inline void for_each_alphabet(std::span<const uint8_t> buf, uint64_t stride, Func &&func) {
+    auto consume = [&](auto &&data) {
+        while (!data.empty()) {
+            func(data.next());
+        }
+    };
+
+    switch (stride) {
+    case 8:
+        consume(AlignedAlphabetStream<KeyType, 8>{buf});
+        return;
+    case 16:
+        if constexpr (sizeof (KeyType) >= sizeof (uint16_t)) {
+            consume(AlignedAlphabetStream<KeyType, 16>{buf});
+            return;
+        }
+        break;
+    case 32:
+        if constexpr (sizeof (KeyType) >= sizeof (uint32_t)) {
+            consume(AlignedAlphabetStream<KeyType, 32>{buf});
+            return;
+        }
+        break;
+    case 64:
+        if constexpr (sizeof (KeyType) >= sizeof (uint64_t)) {
+            consume(AlignedAlphabetStream<KeyType, 64>{buf});
+            return;
+        }
+        break;
+    }
+
+    consume(AlphabetStream<KeyType>{buf, stride});
 }
 
 #endif
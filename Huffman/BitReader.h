@@ -0,0 +1,91 @@
+#ifndef __BIT_READER_H__
+#define __BIT_READER_H__
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// MSB-first reader with a 64-bit refill buffer, reads past the end as zeros
+class BitReader {
+    const uint8_t *data;
+    uint64_t nbytes;
+    uint64_t pos;
+    uint64_t acc;
+    uint64_t nbits;
+    uint64_t consumed;
+
+public:
+    BitReader(const uint8_t *, uint64_t, uint64_t=0);
+    BitReader(std::span<const uint8_t>, uint64_t=0);
+    void refill();
+    uint64_t peek(uint64_t) const;
+    void consume(uint64_t);
+    uint64_t read(uint64_t);
+    uint64_t tell() const;
+    bool empty() const;
+};
+
+inline BitReader::BitReader(const uint8_t *data, uint64_t nbytes, uint64_t bit_offset) :
+    data(data), nbytes(nbytes), pos(bit_offset / 8), acc(0), nbits(0), consumed(bit_offset / 8 * 8) {
+    refill();
+    consume(bit_offset % 8);
+}
+
+inline BitReader::BitReader(std::span<const uint8_t> buf, uint64_t bit_offset) : BitReader(buf.data(), buf.size(), bit_offset) {}
+
+// at least 56 bits are available after refill
+inline void BitReader::refill() {
+    if (pos + sizeof (uint64_t) <= nbytes) [[likely]] {
+        uint64_t word;
+        std::memcpy(&word, data + pos, sizeof (uint64_t));
+
+        if constexpr (std::endian::native == std::endian::little) {
+            word = __builtin_bswap64(word);
+        }
+
+        acc |= word >> nbits;
+        pos += (63 - nbits) >> 3;
+        nbits |= 56;
+    }
+    else {
+        while (nbits <= 56) {
+            uint64_t byte = pos < nbytes ? data[pos] : 0;
+
+            acc |= byte << (56 - nbits);
+            pos++;
+            nbits += 8;
+        }
+    }
+}
+
+// 1 <= n <= bits available
+inline uint64_t BitReader::peek(uint64_t n) const {
+    return acc >> (64 - n);
+}
+
+inline void BitReader::consume(uint64_t n) {
+    acc <<= n;
+    nbits -= n;
+    consumed += n;
+}
+
+// 1 <= n <= 56
+inline uint64_t BitReader::read(uint64_t n) {
+    refill();
+
+    uint64_t val = peek(n);
+    consume(n);
+
+    return val;
+}
+
+inline uint64_t BitReader::tell() const {
+    return consumed;
+}
+
+inline bool BitReader::empty() const {
+    return consumed >= nbytes * 8;
+}
+
+#endif
@@ -2,20 +2,20 @@
 #define __BIT_STREAM_H__
 
 #include <cstdint>
-#include <vector>
+#include <span>
 
 class BitStream {
-    const std::vector<uint8_t> &buf;
+    std::span<const uint8_t> buf;
     uint64_t idx;
     int8_t bidx;
 
 public:
-    BitStream(const std::vector<uint8_t> &);
+    BitStream(std::span<const uint8_t>);
     bool next();
     bool empty() const;
 };
 
-inline BitStream::BitStream(const std::vector<uint8_t> &buf) : buf(buf), idx(0), bidx(7) {}
+inline BitStream::BitStream(std::span<const uint8_t> buf) : buf(buf), idx(0), bidx(7) {}
 
 inline bool BitStream::next() {
     if (bidx == -1) [[unlikely]] {
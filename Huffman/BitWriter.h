@@ -0,0 +1,79 @@
+#ifndef __BIT_WRITER_H__
+#define __BIT_WRITER_H__
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// MSB-first bit packer, the writing counterpart of BitStream
+class BitWriter {
+    std::vector<uint8_t> buf;
+    uint64_t acc;
+    uint64_t nbits;
+
+    void flush_word();
+
+public:
+    BitWriter(uint64_t=0);
+    void write(uint64_t, uint64_t);
+    uint64_t size() const;
+    std::vector<uint8_t> flush();
+};
+
+inline BitWriter::BitWriter(uint64_t reserved_bytes) : acc(0), nbits(0) {
+    buf.reserve(reserved_bytes + sizeof (uint64_t));
+}
+
+inline void BitWriter::flush_word() {
+    uint64_t word = acc;
+
+    if constexpr (std::endian::native == std::endian::little) {
+        word = __builtin_bswap64(word);
+    }
+
+    uint64_t n = buf.size();
+    buf.resize(n + sizeof (uint64_t));
+    std::memcpy(buf.data() + n, &word, sizeof (uint64_t));
+}
+
+// code must not have bits set above len, len <= 64
+inline void BitWriter::write(uint64_t code, uint64_t len) {
+    if (nbits + len < 64) [[likely]] {
+        acc = len ? (acc << len) | code : acc;
+        nbits += len;
+        return;
+    }
+
+    uint64_t room = 64 - nbits;
+    uint64_t rest = len - room;
+
+    acc = room == 64 ? code : (acc << room) | (code >> rest);
+    flush_word();
+
+    acc = rest ? code & ((uint64_t{1} << rest) - 1) : 0;
+    nbits = rest;
+}
+
+inline uint64_t BitWriter::size() const {
+    return buf.size() * 8 + nbits;
+}
+
+// pads the last byte with zeros
+inline std::vector<uint8_t> BitWriter::flush() {
+    if (nbits) {
+        uint64_t word = acc << (64 - nbits);
+
+        for (uint64_t i = 0; i < (nbits + 7) / 8; i++) {
+            buf.push_back((uint8_t)(word >> (56 - 8*i)));
+        }
+    }
+
+    acc = 0;
+    nbits = 0;
+
+    return std::move(buf);
+}
+
+#endif
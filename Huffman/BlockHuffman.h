@@ -0,0 +1,344 @@
+#ifndef __BLOCK_HUFFMAN_H__
+#define __BLOCK_HUFFMAN_H__
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "AlphabetStream.h"
+#include "BitReader.h"
+#include "BitWriter.h"
+#include "CanonicalCode.h"
+#include "Huffman.h"
+#include "HuffmanDecoder.h"
+
+// Container of independently coded blocks, each with its own canonical table,
+// so blocks are encoded on all cores and any one of them decodes on its own.
+// Blocks are block_size bytes rounded down to a multiple of lcm(8, stride) bits.
+//
+//   header  u64 stride, block_size, nbytes, nblocks (little-endian)
+//   index   u64 offsets[nblocks + 1], byte offsets of the blocks in the container
+//   block   32-bit table size n, 7-bit max length L, 32-bit count of each
+//           length 1..L, the n symbols in canonical order (stride bits each),
+//           then the codewords, MSB-first and zero-padded to a byte
+//
+// Decoding validates the header, the index and each block's table before use
+// and throws std::runtime_error on a truncated or corrupt container.
+template <typename KeyType, typename ValueType=uint64_t>
+class BlockHuffman {
+    static constexpr uint64_t header_words = 4;
+
+    uint64_t stride;
+    uint64_t block_size;
+    uint64_t max_code_length;
+    uint64_t root_bits;
+
+    std::chrono::duration<double> encode_time;
+    std::chrono::duration<double> decode_time;
+    uint64_t input_bytes;
+    uint64_t output_bytes;
+    uint64_t table_bits;
+    uint64_t decoded_bytes;
+
+    static void store_u64(uint8_t *data, uint64_t val) {
+        if constexpr (std::endian::native == std::endian::big) {
+            val = __builtin_bswap64(val);
+        }
+
+        std::memcpy(data, &val, sizeof (uint64_t));
+    }
+
+    static uint64_t load_u64(const uint8_t *data) {
+        uint64_t val;
+        std::memcpy(&val, data, sizeof (uint64_t));
+
+        if constexpr (std::endian::native == std::endian::big) {
+            val = __builtin_bswap64(val);
+        }
+
+        return val;
+    }
+
+    uint64_t count_symbols(uint64_t nbytes) const {
+        return (nbytes * 8 + stride - 1) / stride;
+    }
+
+    static void corrupt(const char *what) {
+        throw std::runtime_error(std::string("BlockHuffman: ") + what);
+    }
+
+    // the header and index fit in the container and describe nbytes of this stride
+    void check_header(std::span<const uint8_t> container) const {
+        if (container.size() < header_words * sizeof (uint64_t)) corrupt("container shorter than its header");
+
+        const uint64_t c_stride = load_u64(container.data());
+        const uint64_t c_block_size = load_u64(container.data() + 8);
+        const uint64_t c_nbytes = load_u64(container.data() + 16);
+        const uint64_t nblocks = load_u64(container.data() + 24);
+
+        if (c_stride != stride) corrupt("stride does not match");
+        if (c_block_size == 0 || c_block_size % (std::lcm(8, stride) / 8)) corrupt("invalid block size");
+        if (nblocks != c_nbytes / c_block_size + (c_nbytes % c_block_size != 0)) corrupt("block count does not match the size");
+        if (nblocks >= container.size() / sizeof (uint64_t) - header_words) corrupt("container shorter than its index");
+    }
+
+    // byte range of block idx, after check_header
+    std::pair<uint64_t, uint64_t> block_range(std::span<const uint8_t> container, uint64_t idx) const {
+        const uint64_t nblocks = count_blocks(container);
+
+        if (idx >= nblocks) corrupt("block index out of range");
+
+        const uint64_t begin = load_u64(container.data() + (header_words + idx) * sizeof (uint64_t));
+        const uint64_t end = load_u64(container.data() + (header_words + idx + 1) * sizeof (uint64_t));
+
+        if (begin < (header_words + nblocks + 1) * sizeof (uint64_t) || begin > end || end > container.size()) corrupt("block offsets out of range");
+
+        return {begin, end};
+    }
+
+    // returns the block and the number of bits its table took
+    std::pair<std::vector<uint8_t>, uint64_t> encode_block(std::span<const uint8_t> block) const {
+        Huffman<KeyType, ValueType, false, false, true> huf{block, stride, max_code_length};
+        const CanonicalCode<KeyType> &code = huf.get_code();
+
+        std::vector<uint64_t> count(code.get_max_length() + 1, 0);
+
+        for (uint64_t i = 0; i < code.size(); i++) {
+            count[code.get_length(i)]++;
+        }
+
+        BitWriter writer{block.size()};
+
+        writer.write(code.size(), 32);
+        writer.write(code.get_max_length(), 7);
+
+        for (uint64_t l = 1; l <= code.get_max_length(); l++) {
+            writer.write(count[l], 32);
+        }
+
+        for (uint64_t i = 0; i < code.size(); i++) {
+            write_symbol(writer, code.get_symbol(i), stride);
+        }
+
+        uint64_t nbits = writer.size();
+
+        for_each_alphabet<KeyType>(block, stride, [&](KeyType alphabet) {
+            uint64_t idx = code.find(alphabet);
+            writer.write(code.get_code(idx), code.get_length(idx));
+        });
+
+        return {writer.flush(), nbits};
+    }
+
+public:
+    BlockHuffman(uint64_t stride, uint64_t block_size=1 * 1024 * 1024, uint64_t max_code_length=0, uint64_t root_bits=11) :
+    stride(stride), max_code_length(max_code_length), root_bits(root_bits), encode_time(0), decode_time(0), input_bytes(0), output_bytes(0), table_bits(0), decoded_bytes(0) {
+        uint64_t lcm = std::lcm(8, stride) / 8;
+        this->block_size = std::max(lcm, lcm * (block_size / lcm));
+    }
+
+    std::vector<uint8_t> encode(std::span<const uint8_t> buf) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        const uint64_t nblocks = (buf.size() + block_size - 1) / block_size;
+        std::vector<std::vector<uint8_t>> blocks(nblocks);
+        std::vector<uint64_t> block_table_bits(nblocks, 0);
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (uint64_t i = 0; i < nblocks; i++) {
+            auto [bits, nbits] = encode_block(buf.subspan(i*block_size, std::min(block_size, buf.size() - i*block_size)));
+
+            blocks[i] = std::move(bits);
+            block_table_bits[i] = nbits;
+        }
+
+        std::vector<uint64_t> offsets(nblocks + 1);
+        offsets[0] = (header_words + nblocks + 1) * sizeof (uint64_t);
+
+        for (uint64_t i = 0; i < nblocks; i++) {
+            offsets[i + 1] = offsets[i] + blocks[i].size();
+        }
+
+        std::vector<uint8_t> container(offsets[nblocks]);
+
+        store_u64(container.data(), stride);
+        store_u64(container.data() + 8, block_size);
+        store_u64(container.data() + 16, buf.size());
+        store_u64(container.data() + 24, nblocks);
+
+        for (uint64_t i = 0; i <= nblocks; i++) {
+            store_u64(container.data() + (header_words + i) * sizeof (uint64_t), offsets[i]);
+        }
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (uint64_t i = 0; i < nblocks; i++) {
+            std::memcpy(container.data() + offsets[i], blocks[i].data(), blocks[i].size());
+        }
+
+        encode_time = std::chrono::high_resolution_clock::now() - start_time;
+        input_bytes = buf.size();
+        output_bytes = container.size();
+        table_bits = std::accumulate(block_table_bits.begin(), block_table_bits.end(), uint64_t{0});
+
+        return container;
+    }
+
+    static uint64_t count_blocks(std::span<const uint8_t> container) {
+        return container.size() < header_words * sizeof (uint64_t) ? 0 : load_u64(container.data() + 24);
+    }
+
+    // decodes block idx alone, using only the header, its index entry and its own bytes
+    std::vector<uint8_t> decode_block(std::span<const uint8_t> container, uint64_t idx) const {
+        check_header(container);
+
+        const uint64_t c_block_size = load_u64(container.data() + 8);
+        const uint64_t c_nbytes = load_u64(container.data() + 16);
+        const auto [begin, end] = block_range(container, idx);
+        const uint64_t nbytes = std::min(c_block_size, c_nbytes - idx*c_block_size);
+
+        BitReader reader{container.data() + begin, end - begin};
+
+        reader.refill();
+        const uint64_t nsymbols = reader.read(32);
+        const uint64_t max_length = reader.read(7);
+
+        if (max_length > 64) corrupt("codeword length exceeds 64 bits");
+
+        // the table of a well-formed block fits in it, every symbol takes stride bits
+        if (nsymbols > (end - begin) * 8 / stride) corrupt("table larger than its block");
+        if (nsymbols == 0 && nbytes) corrupt("empty table");
+
+        std::vector<uint64_t> count(max_length + 1, 0);
+        __uint128_t total = 0;
+        __uint128_t kraft = 0;
+
+        for (uint64_t l = 1; l <= max_length; l++) {
+            count[l] = reader.read(32);
+            total += count[l];
+            kraft += (__uint128_t)count[l] << (max_length - l);
+        }
+
+        // a single-symbol block has max_length 0 and no counts, its one codeword is empty
+        if (max_length == 0 ? nsymbols != 1 : total != nsymbols) corrupt("length counts do not add up to the table size");
+
+        // an oversubscribed code would overrun the decoder's tables
+        if (kraft > (__uint128_t)1 << max_length) corrupt("code lengths violate the Kraft inequality");
+
+        std::vector<std::pair<KeyType, uint8_t>> code_lengths(nsymbols);
+        uint64_t i = 0;
+
+        for (uint64_t l = 1; l <= max_length; l++) {
+            for (uint64_t n = count[l]; n > 0; n--) {
+                code_lengths[i++].second = l;
+            }
+        }
+
+        for (auto &[symbol, length] : code_lengths) {
+            symbol = read_symbol<KeyType>(reader, stride);
+        }
+
+        HuffmanDecoder<KeyType> decoder{CanonicalCode<KeyType>{std::move(code_lengths), stride}, root_bits};
+        BitWriter writer{nbytes};
+
+        for (uint64_t n = (nbytes * 8 + stride - 1) / stride; n > 0; n--) {
+            write_symbol(writer, decoder.decode_symbol(reader), stride);
+        }
+
+        std::vector<uint8_t> block = writer.flush();
+        block.resize(nbytes);
+
+        return block;
+    }
+
+    std::vector<uint8_t> decode(std::span<const uint8_t> container) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        check_header(container);
+
+        const uint64_t c_block_size = load_u64(container.data() + 8);
+        const uint64_t nbytes = load_u64(container.data() + 16);
+        const uint64_t nblocks = count_blocks(container);
+
+        for (uint64_t i = 0; i < nblocks; i++) {
+            block_range(container, i);
+        }
+
+        std::vector<uint8_t> buf(nbytes);
+        std::exception_ptr error;
+
+        // an exception must not leave the parallel region, the first one is rethrown after it
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (uint64_t i = 0; i < nblocks; i++) {
+            try {
+                std::vector<uint8_t> block = decode_block(container, i);
+                std::memcpy(buf.data() + i*c_block_size, block.data(), block.size());
+            }
+            catch (...) {
+                #pragma omp critical
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        decode_time = std::chrono::high_resolution_clock::now() - start_time;
+        decoded_bytes = nbytes;
+
+        return buf;
+    }
+
+    uint64_t get_block_size() const {
+        return block_size;
+    }
+
+    uint64_t get_encoded_size() const {
+        return output_bytes;
+    }
+
+    double get_compression_ratio() const {
+        return 1.0 * input_bytes / output_bytes;
+    }
+
+    // share of the container taken by the per-block tables, header and index
+    double get_table_overhead() const {
+        uint64_t index_bytes = output_bytes ? (header_words + (input_bytes + block_size - 1) / block_size + 1) * sizeof (uint64_t) : 0;
+        return output_bytes ? (table_bits / 8.0 + index_bytes) / output_bytes : 0;
+    }
+
+    double get_encode_throughput() const {
+        return input_bytes / (1024.0 * 1024.0) / encode_time.count();
+    }
+
+    double get_decode_throughput() const {
+        return decoded_bytes / (1024.0 * 1024.0) / decode_time.count();
+    }
+
+    void dump() {
+        std::cout << "Symbol Length:            " << stride                       << " (bit)"  << std::endl;
+        std::cout << "Block Size:               " << block_size                   << " (byte)" << std::endl;
+        std::cout << "Blocks:                   " << (input_bytes + block_size - 1) / block_size << std::endl;
+        std::cout << "Encoded Size:             " << output_bytes                 << " (byte)" << std::endl;
+        std::cout << "Compression Ratio:        " << get_compression_ratio()      << std::endl;
+        std::cout << "Table Overhead:           " << get_table_overhead() * 100   << " (%)"    << std::endl;
+        std::cout << "Encode Throughput:        " << get_encode_throughput()      << " (MB/s)" << std::endl;
+
+        if (decoded_bytes) {
+            std::cout << "Decode Throughput:        " << get_decode_throughput() << " (MB/s)" << std::endl;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef __CANONICAL_CODE_H__
+#define __CANONICAL_CODE_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Frequency.h"
+
+// Codewords are assigned in (length, symbol) order, so the code lengths alone
+// are enough to rebuild the whole table on the decoder side. Codewords longer
+// than 64 bits (one BitWriter write) and lookups of symbols outside the table
+// throw, also in release builds.
+template <typename KeyType>
+class CanonicalCode {
+    static constexpr uint64_t dense_stride = 20;
+    static constexpr uint32_t absent = UINT32_MAX;
+
+    std::vector<KeyType> symbols;
+    std::vector<uint8_t> lengths;
+    std::vector<uint64_t> codes;
+
+    std::vector<uint32_t> dense_index;
+    std::unordered_map<KeyType, uint32_t> sparse_index;
+
+    uint64_t stride;
+    uint64_t max_length;
+
+public:
+    CanonicalCode();
+    CanonicalCode(std::vector<std::pair<KeyType, uint8_t>>, uint64_t);
+    uint64_t size() const;
+    uint64_t get_stride() const;
+    uint64_t get_max_length() const;
+    KeyType get_symbol(uint64_t) const;
+    uint8_t get_length(uint64_t) const;
+    uint64_t get_code(uint64_t) const;
+    uint64_t find(KeyType) const;
+};
+
+template <typename KeyType>
+CanonicalCode<KeyType>::CanonicalCode() : stride(0), max_length(0) {}
+
+template <typename KeyType>
+CanonicalCode<KeyType>::CanonicalCode(std::vector<std::pair<KeyType, uint8_t>> code_lengths, uint64_t stride) :
+    stride(stride), max_length(0) {
+    std::sort(code_lengths.begin(), code_lengths.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.second != rhs.second ? lhs.second < rhs.second : lhs.first < rhs.first;
+    });
+
+    symbols.resize(code_lengths.size());
+    lengths.resize(code_lengths.size());
+    codes.resize(code_lengths.size());
+
+    uint64_t code = 0;
+
+    for (uint64_t i = 0; i < code_lengths.size(); i++) {
+        auto &[symbol, length] = code_lengths[i];
+
+        if (length > 64) {
+            throw std::length_error("CanonicalCode: codeword length " + std::to_string(length) + " exceeds 64 bits");
+        }
+
+        if (i > 0) [[likely]] {
+            code = (code + 1) << (length - lengths[i - 1]);
+        }
+
+        symbols[i] = symbol;
+        lengths[i] = length;
+        codes[i] = code;
+    }
+
+    if (!lengths.empty()) {
+        max_length = lengths.back();
+    }
+
+    if (stride <= dense_stride) {
+        dense_index.resize(uint64_t{1} << stride, absent);
+
+        for (uint64_t i = 0; i < symbols.size(); i++) {
+            dense_index[(uint64_t)symbols[i]] = i;
+        }
+    }
+    else {
+        sparse_index.reserve(symbols.size());
+
+        for (uint64_t i = 0; i < symbols.size(); i++) {
+            sparse_index[symbols[i]] = i;
+        }
+    }
+}
+
+template <typename KeyType>
+uint64_t CanonicalCode<KeyType>::size() const {
+    return symbols.size();
+}
+
+template <typename KeyType>
+uint64_t CanonicalCode<KeyType>::get_stride() const {
+    return stride;
+}
+
+template <typename KeyType>
+uint64_t CanonicalCode<KeyType>::get_max_length() const {
+    return max_length;
+}
+
+template <typename KeyType>
+KeyType CanonicalCode<KeyType>::get_symbol(uint64_t idx) const {
+    return symbols[idx];
+}
+
+template <typename KeyType>
+uint8_t CanonicalCode<KeyType>::get_length(uint64_t idx) const {
+    return lengths[idx];
+}
+
+template <typename KeyType>
+uint64_t CanonicalCode<KeyType>::get_code(uint64_t idx) const {
+    return codes[idx];
+}
+
+template <typename KeyType>
+uint64_t CanonicalCode<KeyType>::find(KeyType symbol) const {
+    if (stride <= dense_stride) {
+        uint32_t idx = dense_index[(uint64_t)symbol];
+
+        if (idx == absent) [[unlikely]] {
+            throw std::out_of_range("CanonicalCode: symbol not in the code table");
+        }
+
+        return idx;
+    }
+    else {
+        auto it = sparse_index.find(symbol);
+
+        if (it == sparse_index.end()) [[unlikely]] {
+            throw std::out_of_range("CanonicalCode: symbol not in the code table");
+        }
+
+        return it->second;
+    }
+}
+
+#endif
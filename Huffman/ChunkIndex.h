@@ -0,0 +1,209 @@
+#ifndef __CHUNK_INDEX_H__
+#define __CHUNK_INDEX_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "AlphabetStream.h"
+#include "Frequency.h"
+#include "Histogram.h"
+
+// Per-chunk histograms of a buffer, counted once in parallel. The statistics of
+// any window made of whole chunks (a 40MB slice, a sliding window, the whole
+// file) are then a merge of chunk histograms instead of a rescan. Chunks are
+// about chunk_size bytes, rounded down to a multiple of lcm(8, stride) bits so
+// no symbol straddles two chunks. Each chunk keeps its sorted (key, count)
+// runs, a chunk never holds more than 2^32 symbols.
+template <typename KeyType, typename ValueType=uint64_t, typename FreqType=Frequency<KeyType, ValueType>>
+class ChunkIndex {
+    struct ChunkHistogram {
+        std::vector<KeyType> keys;
+        std::vector<uint32_t> counts;
+    };
+
+    struct MergedRuns {
+        std::vector<KeyType> keys;
+        std::vector<ValueType> counts;
+    };
+
+    static constexpr uint64_t dense_bits = 16;
+
+    std::vector<ChunkHistogram> chunks;
+    uint64_t stride;
+    uint64_t chunk_size;
+    uint64_t nbytes;
+    std::chrono::duration<double> elapsed_time;
+
+    void build_chunk(std::span<const uint8_t> chunk, ChunkHistogram &hist, std::vector<KeyType> &keys, std::vector<uint64_t> &counts) {
+        // narrow strides count into a dense array, wide ones sort the chunk's symbols
+        if (stride <= dense_bits) {
+            std::fill(counts.begin(), counts.end(), 0);
+
+            if (sizeof (KeyType) * 8 >= stride && (stride == 8 || stride == 16)) {
+                (stride == 8 ? histogram_8 : histogram_16)(chunk.data(), chunk.size(), counts.data());
+            }
+            else {
+                for_each_alphabet<KeyType>(chunk, stride, [&](KeyType alphabet) {
+                    counts[(uint64_t)alphabet]++;
+                });
+            }
+
+            for (uint64_t k = 0; k < counts.size(); k++) {
+                if (counts[k]) {
+                    hist.keys.push_back(k);
+                    hist.counts.push_back(counts[k]);
+                }
+            }
+
+            return;
+        }
+
+        keys.clear();
+
+        for_each_alphabet<KeyType>(chunk, stride, [&](KeyType alphabet) {
+            keys.push_back(alphabet);
+        });
+
+        std::sort(keys.begin(), keys.end());
+
+        for (uint64_t i = 0; i < keys.size(); i++) {
+            if (hist.keys.empty() || hist.keys.back() != keys[i]) {
+                hist.keys.push_back(keys[i]);
+                hist.counts.push_back(1);
+            }
+            else {
+                hist.counts.back()++;
+            }
+        }
+    }
+
+    template <typename LHS, typename RHS>
+    static MergedRuns merge_runs(const LHS &lhs, const RHS &rhs) {
+        MergedRuns out;
+        uint64_t i = 0;
+        uint64_t j = 0;
+
+        out.keys.reserve(lhs.keys.size() + rhs.keys.size());
+        out.counts.reserve(lhs.keys.size() + rhs.keys.size());
+
+        while (i < lhs.keys.size() || j < rhs.keys.size()) {
+            if (j == rhs.keys.size() || (i < lhs.keys.size() && lhs.keys[i] < rhs.keys[j])) {
+                out.keys.push_back(lhs.keys[i]);
+                out.counts.push_back(lhs.counts[i++]);
+            }
+            else if (i == lhs.keys.size() || rhs.keys[j] < lhs.keys[i]) {
+                out.keys.push_back(rhs.keys[j]);
+                out.counts.push_back(rhs.counts[j++]);
+            }
+            else {
+                out.keys.push_back(lhs.keys[i]);
+                out.counts.push_back((ValueType)lhs.counts[i++] + rhs.counts[j++]);
+            }
+        }
+
+        return out;
+    }
+
+public:
+    ChunkIndex(std::span<const uint8_t> buf, uint64_t stride, uint64_t chunk_size=1 * 1024 * 1024) : stride(stride), nbytes(buf.size()) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        uint64_t lcm = std::lcm(8, stride) / 8;
+        this->chunk_size = std::max(lcm, lcm * (chunk_size / lcm));
+
+        chunks.resize((buf.size() + this->chunk_size - 1) / this->chunk_size);
+
+        #pragma omp parallel
+        {
+            std::vector<KeyType> keys;
+            std::vector<uint64_t> counts(stride <= dense_bits ? uint64_t{1} << stride : 0);
+
+            #pragma omp for schedule(dynamic, 1)
+            for (uint64_t i = 0; i < chunks.size(); i++) {
+                uint64_t offset = i * this->chunk_size;
+                build_chunk(buf.subspan(offset, std::min(this->chunk_size, buf.size() - offset)), chunks[i], keys, counts);
+            }
+        }
+
+        elapsed_time = std::chrono::high_resolution_clock::now() - start_time;
+    }
+
+    uint64_t get_chunk_size() const {
+        return chunk_size;
+    }
+
+    uint64_t count_chunks() const {
+        return chunks.size();
+    }
+
+    uint64_t get_stride() const {
+        return stride;
+    }
+
+    double get_execution_time() const {
+        return elapsed_time.count();
+    }
+
+    // statistics of chunks [first, last): the sorted runs are merged pairwise in
+    // log2(#chunks) parallel rounds, then every distinct key is counted once
+    FreqType merge(uint64_t first, uint64_t last) {
+        last = std::min<uint64_t>(last, chunks.size());
+        first = std::min(first, last);
+
+        FreqType freq{KeyType{1} << stride};
+        std::vector<MergedRuns> level((last - first + 1) / 2);
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (uint64_t p = 0; p < level.size(); p++) {
+            uint64_t i = first + 2*p;
+            level[p] = i + 1 < last ? merge_runs(chunks[i], chunks[i + 1]) : merge_runs(chunks[i], MergedRuns{});
+        }
+
+        while (level.size() > 1) {
+            std::vector<MergedRuns> next((level.size() + 1) / 2);
+
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (uint64_t p = 0; p < next.size(); p++) {
+                next[p] = 2*p + 1 < level.size() ? merge_runs(level[2*p], level[2*p + 1]) : std::move(level[2*p]);
+            }
+
+            std::swap(level, next);
+        }
+
+        if (!level.empty()) {
+            for (uint64_t j = 0; j < level[0].keys.size(); j++) {
+                freq.count(level[0].keys[j], level[0].counts[j]);
+            }
+        }
+
+        return freq;
+    }
+
+    // the window must start on a chunk boundary and end on one or at the end of the
+    // buffer, anything else would cover other bytes than requested and throws
+    FreqType window(uint64_t offset, uint64_t length) {
+        length = std::min(length, nbytes - std::min(offset, nbytes));
+
+        if (offset % chunk_size || (length % chunk_size && offset + length != nbytes)) {
+            throw std::invalid_argument("ChunkIndex: window is not aligned to chunk boundaries");
+        }
+
+        return merge(offset / chunk_size, (offset + length + chunk_size - 1) / chunk_size);
+    }
+
+    FreqType whole() {
+        return merge(0, chunks.size());
+    }
+};
+
+#endif
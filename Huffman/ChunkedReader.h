@@ -0,0 +1,123 @@
+#ifndef __CHUNKED_READER_H__
+#define __CHUNKED_READER_H__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Reads a file through one fixed-size buffer. Every chunk but the last ends on a
+// symbol boundary (a multiple of lcm(8, stride) bits), the bytes of a partial
+// symbol are carried over to the front of the next chunk. Streaming the chunks
+// yields exactly the symbols of the whole file read at once.
+class ChunkedReader {
+    int fd;
+    uint64_t stride;
+    uint64_t align;
+    std::vector<uint8_t> buf;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t nread;
+    bool eof;
+    int error;
+
+public:
+    ChunkedReader(const std::string &, uint64_t, uint64_t=64 * 1024 * 1024);
+    ChunkedReader(const ChunkedReader &) = delete;
+    ChunkedReader & operator=(const ChunkedReader &) = delete;
+    ~ChunkedReader();
+    bool fail() const;
+    int get_error() const;
+    std::span<const uint8_t> next();
+    uint64_t get_stride() const;
+    uint64_t get_chunk_size() const;
+    uint64_t tell() const;
+};
+
+inline ChunkedReader::ChunkedReader(const std::string &path, uint64_t stride, uint64_t chunk_size) :
+    fd(open(path.c_str(), O_RDONLY)), stride(stride), align(std::lcm(uint64_t{8}, stride) / 8), begin(0), end(0), nread(0), eof(false), error(fd < 0 ? errno : 0) {
+    buf.resize(std::max(align, chunk_size / align * align));
+
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+}
+
+inline ChunkedReader::~ChunkedReader() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+// the file could not be opened or a read failed, the chunks handed out are not the whole file
+inline bool ChunkedReader::fail() const {
+    return fd < 0 || error != 0;
+}
+
+// errno of the failed open or read, 0 if none failed
+inline int ChunkedReader::get_error() const {
+    return error;
+}
+
+// returns an empty span at the end of the file or on a read error (see fail()), the
+// span is valid until the next call
+inline std::span<const uint8_t> ChunkedReader::next() {
+    if (fail()) {
+        begin = end = 0;
+        return {};
+    }
+
+    uint64_t carry = end - begin;
+
+    std::memmove(buf.data(), buf.data() + begin, carry);
+    end = carry;
+
+    while (!eof && end < buf.size()) {
+        ssize_t n = read(fd, buf.data() + end, buf.size() - end);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n < 0) {
+            error = errno;
+            begin = end = 0;
+            return {};
+        }
+
+        if (n == 0) {
+            eof = true;
+        }
+        else {
+            end += n;
+        }
+    }
+
+    // only the last chunk may end in the middle of a symbol
+    begin = eof ? end : end / align * align;
+    nread += begin;
+
+    return {buf.data(), begin};
+}
+
+inline uint64_t ChunkedReader::get_stride() const {
+    return stride;
+}
+
+inline uint64_t ChunkedReader::get_chunk_size() const {
+    return buf.size();
+}
+
+// bytes handed out so far
+inline uint64_t ChunkedReader::tell() const {
+    return nread;
+}
+
+#endif
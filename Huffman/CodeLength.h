@@ -0,0 +1,160 @@
+#ifndef __CODE_LENGTH_H__
+#define __CODE_LENGTH_H__
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Moffat-Katajainen in-place minimum-redundancy code, weights must be sorted in
+// nondecreasing order. On return weights[i] holds the code length of the i-th
+// weight, and the sum of internal node weights (the encoded size) is returned.
+template <typename ValueType>
+ValueType in_place_code_lengths(std::vector<ValueType> &weights) {
+    const int64_t n = weights.size();
+    ValueType internal_sum = 0;
+
+    if (n == 0) return 0;
+
+    if (n == 1) {
+        weights[0] = 0;
+        return 0;
+    }
+
+    // 1st pass: left to right, internal weights are overwritten by parent pointers
+    int64_t root = 0;
+    int64_t leaf = 2;
+
+    weights[0] += weights[1];
+    internal_sum += weights[0];
+
+    for (int64_t next = 1; next < n - 1; next++) {
+        if (leaf >= n || weights[root] < weights[leaf]) {
+            weights[next] = weights[root];
+            weights[root++] = next;
+        }
+        else {
+            weights[next] = weights[leaf++];
+        }
+
+        if (leaf >= n || (root < next && weights[root] < weights[leaf])) {
+            weights[next] += weights[root];
+            weights[root++] = next;
+        }
+        else {
+            weights[next] += weights[leaf++];
+        }
+
+        internal_sum += weights[next];
+    }
+
+    // 2nd pass: right to left, internal depths
+    weights[n - 2] = 0;
+
+    for (int64_t next = n - 3; next >= 0; next--) {
+        weights[next] = weights[(int64_t)weights[next]] + 1;
+    }
+
+    // 3rd pass: right to left, leaf depths
+    int64_t avbl = 1;
+    int64_t used = 0;
+    int64_t depth = 0;
+    int64_t next = n - 1;
+
+    root = n - 2;
+
+    while (avbl > 0) {
+        while (root >= 0 && (int64_t)weights[root] == depth) {
+            used++;
+            root--;
+        }
+
+        while (avbl > used) {
+            weights[next--] = depth;
+            avbl--;
+        }
+
+        avbl = 2 * used;
+        depth++;
+        used = 0;
+    }
+
+    return internal_sum;
+}
+
+// Caps a histogram of code lengths (count[l] codewords of length l) at max_length.
+// Overflowing codewords are clamped, then the Kraft sum is repaired by moving the
+// deepest codeword shorter than max_length one level down, like zlib does.
+inline void limit_length_count(std::vector<uint64_t> &count, uint64_t max_length) {
+    for (uint64_t i = max_length + 1; i < count.size(); i++) {
+        count[max_length] += count[i];
+        count[i] = 0;
+    }
+
+    uint64_t total = 0;
+
+    for (uint64_t i = 1; i <= max_length; i++) {
+        total += count[i] << (max_length - i);
+    }
+
+    while (total > uint64_t{1} << max_length) {
+        count[max_length]--;
+
+        for (uint64_t i = max_length - 1; i > 0; i--) {
+            if (count[i]) {
+                count[i]--;
+                count[i + 1] += 2;
+                break;
+            }
+        }
+
+        total--;
+    }
+}
+
+// Limits the code lengths to max_length bits (at least ceil(log2(#symbols))),
+// the least frequent symbols get the longest codewords. Returns the new encoded size.
+template <typename KeyType, typename ValueType, typename FreqType>
+ValueType limit_code_lengths(std::vector<std::pair<KeyType, uint8_t>> &code_lengths, FreqType &freq, uint64_t max_length) {
+    std::vector<uint64_t> count(65, 0);
+    uint64_t longest = 0;
+    ValueType encoded_size = 0;
+
+    for (auto &[key, length] : code_lengths) {
+        count[length]++;
+        longest = std::max<uint64_t>(longest, length);
+    }
+
+    if (code_lengths.size() > 1) {
+        max_length = std::max<uint64_t>(max_length, std::bit_width(code_lengths.size() - 1));
+    }
+
+    if (longest > max_length) {
+        std::vector<std::pair<ValueType, uint64_t>> order(code_lengths.size());
+
+        for (uint64_t i = 0; i < code_lengths.size(); i++) {
+            order[i] = {freq[code_lengths[i].first], i};
+        }
+
+        std::sort(order.begin(), order.end());
+        limit_length_count(count, max_length);
+
+        uint64_t length = max_length;
+
+        for (auto &[weight, idx] : order) {
+            while (count[length] == 0) length--;
+
+            count[length]--;
+            code_lengths[idx].second = length;
+        }
+    }
+
+    for (auto &[key, length] : code_lengths) {
+        encoded_size += freq[key] * length;
+    }
+
+    return encoded_size;
+}
+
+#endif
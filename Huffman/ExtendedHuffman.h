@@ -2,230 +2,455 @@
 #define __EXTENDED_HUFFMAN_H__
 
 #include <algorithm>
+#include <array>
 #include <bit>
 #include <bitset>
 #include <cassert>
 #include <cstdint>
 #include <chrono>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <queue>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <type_traits>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "AlphabetStream.h"
+#include "CodeLength.h"
 #include "Frequency.h"
-#include "MergeSort.h"
+#include "HuffmanTree.h"
 #include "MinHeap.h"
-#include "Node.h"
-
-template <typename KeyType, typename ValueType, bool par_read=false, bool par_build=false, uint64_t extend_size=1>
+#include "RadixSort.h"
+
+// closed_form keeps only the marginal table and evaluates the extend_size-fold
+// product code from it, so there are no code lengths to limit or look up and
+// a max_code_length is rejected.
+// empirical counts the actual non-overlapping blocks of extend_size symbols
+// instead of assuming they are independent.
+template <typename KeyType, typename ValueType, bool par_read=false, bool par_build=false, uint64_t extend_size=1, bool closed_form=false, bool empirical=false>
 class ExtendedHuffman {
+    static_assert(!(closed_form && empirical), "closed_form assumes independent symbols");
+
+    static constexpr bool product_form = closed_form && extend_size > 1;
+    static constexpr bool block_form = empirical && extend_size > 1;
+
     Frequency<KeyType, ValueType> freq;
     uint64_t stride;
     std::chrono::duration<double> elapsed_time;
     __uint128_t encoded_size;
+    __uint128_t unlimited_size;
+    uint64_t max_code_length;
+
+    std::vector<std::pair<KeyType, uint8_t>> code_lengths;
+
+    uint64_t get_key_width() const {
+        return block_form ? stride * extend_size : stride;
+    }
+
+    // blocks are keyed by shifting their stride-bit fields in, the last block of
+    // the buffer is zero-padded like any other symbol
+    void count_chunk(std::span<const uint8_t> chunk, Frequency<KeyType, ValueType> &f) {
+        if constexpr (block_form) {
+            KeyType key = 0;
+            uint64_t n = 0;
+
+            for_each_alphabet<KeyType>(chunk, stride, [&](KeyType alphabet) {
+                key = (key << stride) | alphabet;
+
+                if (++n == extend_size) {
+                    f.count(key);
+                    key = 0;
+                    n = 0;
+                }
+            });
+
+            if (n) {
+                f.count(key << (stride * (extend_size - n)));
+            }
+        }
+        else {
+            for_each_alphabet<KeyType>(chunk, stride, [&](KeyType alphabet) {
+                f.count(alphabet);
+            });
+        }
+    }
 
-    void build_freq(const std::vector<uint8_t> &buf) {
+    void build_freq(std::span<const uint8_t> buf) {
         if constexpr (par_read) {
-            uint64_t lcm = std::lcm(8, stride);
+            // chunks hold whole blocks
+            uint64_t lcm = std::lcm(8, get_key_width());
             uint64_t step = lcm * (1 * 1024 * 1024 / lcm);
 
-            #pragma omp parallel for schedule(dynamic, 1)
-            for (uint64_t i = 0; i < buf.size() / step; i++) {
-                std::vector<uint8_t>::const_iterator start = buf.begin() + i*step;
-                std::vector<uint8_t>::const_iterator end = buf.begin() + (i + 1)*step;
+            uint64_t nchunks = (buf.size() + step - 1) / step;
+            uint64_t nthreads = 1;
 
-                std::vector<uint8_t> sub_buf{start, end};
-                AlphabetStream<KeyType> data{{sub_buf}, stride};
-                Frequency<KeyType, ValueType> temp{KeyType{1} << stride};
+            #ifdef _OPENMP
+            nthreads = omp_get_max_threads();
+            #endif
 
-                for (uint64_t j = 0; j < step * 8 / stride; j++) {
-                    temp.count(data.next());
-                }
+            std::vector<Frequency<KeyType, ValueType>> local;
+            local.reserve(nthreads);
 
-                #pragma omp critical
-                for (auto &a : temp.get_nonzero_elems()) {
-                    freq.count(a, temp[a]);
-                }
+            for (uint64_t t = 0; t < nthreads; t++) {
+                local.emplace_back(KeyType{1} << get_key_width());
             }
 
-            if (buf.size() / step * step < buf.size()) {
-                std::vector<uint8_t>::const_iterator start = buf.begin() + (buf.size() / step * step);
-                std::vector<uint8_t>::const_iterator end = buf.begin() + buf.size();
+            #pragma omp parallel
+            {
+                uint64_t tid = 0;
 
-                std::vector<uint8_t> sub_buf{start, end};
-                AlphabetStream<KeyType> data{sub_buf, stride};
+                #ifdef _OPENMP
+                tid = omp_get_thread_num();
+                #endif
 
-                while (!data.empty()) {
-                    freq.count(data.next());
+                #pragma omp for schedule(dynamic, 1)
+                for (uint64_t i = 0; i < nchunks; i++) {
+                    count_chunk(buf.subspan(i*step, std::min(step, buf.size() - i*step)), local[tid]);
                 }
             }
-        }
-        else {
-            AlphabetStream<KeyType> data{buf, stride};
 
-            while (!data.empty()) {
-                freq.count(data.next());
+            // pairwise tree reduction, log2(nthreads) rounds without locking
+            for (uint64_t gap = 1; gap < nthreads; gap *= 2) {
+                #pragma omp parallel for schedule(dynamic, 1)
+                for (uint64_t t = 0; t < nthreads - gap; t += 2*gap) {
+                    local[t].merge(local[t + gap]);
+                }
             }
+
+            freq = std::move(local[0]);
+        }
+        else {
+            count_chunk(buf, freq);
         }
 
-        if constexpr (extend_size > 1) {
-            Frequency<KeyType, ValueType> base_freq = freq;
+        if constexpr (extend_size > 1 && !closed_form && !empirical) {
+            std::vector<std::pair<KeyType, ValueType>> base;
+
+            for (auto &key : freq.get_nonzero_elems()) {
+                base.push_back({key, freq[key]});
+            }
 
             for (uint64_t i = 2; i <= extend_size; i++) {
                 Frequency<KeyType, ValueType> temp_freq{KeyType{1} << (stride * i)};
 
                 for (auto &extend_key : freq.get_nonzero_elems()) {
-                    for (auto &base_key : base_freq.get_nonzero_elems()) {
-                        auto new_key = (extend_key << stride) | base_key;
-                        temp_freq.count(new_key, freq[extend_key] * base_freq[base_key]);
+                    ValueType weight = freq[extend_key];
+
+                    for (auto &[base_key, base_weight] : base) {
+                        temp_freq.count((extend_key << stride) | base_key, weight * base_weight);
                     }
                 }
 
-                freq = temp_freq;
+                freq = std::move(temp_freq);
+            }
+        }
+    }
+
+    static __uint128_t power(__uint128_t base, uint64_t exp) {
+        __uint128_t result = 1;
+
+        for (uint64_t i = 0; i < exp; i++) {
+            result *= base;
+        }
+
+        return result;
+    }
+
+    // The product alphabet is i.i.d., so its weights are products of extend_size
+    // marginal weights. Marginal weights are grouped into (weight, multiplicity)
+    // runs, product runs come out of a frontier heap over run indices in
+    // nondecreasing order, and the two-queue builder pairs up whole runs of equal
+    // weight at once. Only the sum of internal weights is kept, which is the
+    // encoded size, so neither the product table nor its tree is ever stored.
+    void build_closed_form() {
+        using Run = std::pair<__uint128_t, __uint128_t>;
+        using Index = std::array<uint64_t, extend_size>;
+
+        struct Entry {
+            __uint128_t weight;
+            __uint128_t count;
+            Index idx;
+            uint64_t last;
+
+            bool operator>(const Entry &other) const {
+                return weight > other.weight;
+            }
+        };
+
+        std::vector<ValueType> weights;
+
+        for (auto &key : freq.get_nonzero_elems()) {
+            weights.push_back(freq[key]);
+        }
+
+        std::sort(weights.begin(), weights.end());
+
+        std::vector<Run> marginal;
+
+        for (ValueType weight : weights) {
+            if (marginal.empty() || marginal.back().first != weight) {
+                marginal.push_back({weight, 1});
+            }
+            else {
+                marginal.back().second++;
+            }
+        }
+
+        if (marginal.empty()) return;
+
+        // a tuple's children raise one index at or after its last nonzero index,
+        // so every tuple is pushed once and never before its smaller parent
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> frontier;
+
+        frontier.push({power(marginal[0].first, extend_size), power(marginal[0].second, extend_size), Index{}, 0});
+
+        auto next_leaf_run = [&]() -> Run {
+            Run run{0, 0};
+
+            while (!frontier.empty() && (run.second == 0 || frontier.top().weight == run.first)) {
+                Entry entry = frontier.top();
+                frontier.pop();
+
+                run = {entry.weight, run.second + entry.count};
+
+                for (uint64_t j = entry.last; j < extend_size; j++) {
+                    if (entry.idx[j] + 1 < marginal.size()) {
+                        const Run &from = marginal[entry.idx[j]];
+                        const Run &to = marginal[entry.idx[j] + 1];
+
+                        Entry child{entry.weight / from.first * to.first, entry.count / from.second * to.second, entry.idx, j};
+                        child.idx[j]++;
+                        frontier.push(child);
+                    }
+                }
+            }
+
+            return run;
+        };
+
+        // internal nodes are created in nondecreasing weight order, equal ones share a run
+        std::deque<Run> internal;
+        Run leaf = next_leaf_run();
+        __uint128_t remaining = power(freq.count_nonzeros(), extend_size);
+
+        auto push_internal = [&](__uint128_t weight, __uint128_t count) {
+            if (!internal.empty() && internal.back().first == weight) {
+                internal.back().second += count;
+            }
+            else {
+                internal.push_back({weight, count});
+            }
+        };
+
+        // takes n items of the smallest weight, n is at most the size of that run
+        auto take = [&](bool from_leaf, __uint128_t n) {
+            if (from_leaf) {
+                if ((leaf.second -= n) == 0) leaf = next_leaf_run();
+            }
+            else {
+                if ((internal.front().second -= n) == 0) internal.pop_front();
+            }
+        };
+
+        auto leaf_first = [&]() {
+            return leaf.second && (internal.empty() || leaf.first <= internal.front().first);
+        };
+
+        while (remaining > 1) {
+            bool from_leaf = leaf_first();
+            Run head = from_leaf ? leaf : internal.front();
+
+            if (head.second >= 2) {
+                __uint128_t pairs = head.second / 2;
+
+                take(from_leaf, 2 * pairs);
+                push_internal(2 * head.first, pairs);
+
+                encoded_size += 2 * head.first * pairs;
+                remaining -= pairs;
+            }
+            else {
+                take(from_leaf, 1);
+
+                bool second_from_leaf = leaf_first();
+                __uint128_t weight = head.first + (second_from_leaf ? leaf.first : internal.front().first);
+
+                take(second_from_leaf, 1);
+                push_internal(weight, 1);
+
+                encoded_size += weight;
+                remaining--;
             }
         }
     }
 
     void build_coding_table() {
+        code_lengths.reserve(freq.count_nonzeros());
+
         if constexpr (par_build) {
-            auto nonzeros = freq.get_nonzero_elems();
+            auto &nonzeros = freq.get_nonzero_elems();
 
-            std::vector<Node<ValueType> *> leaf_nodes(nonzeros.size(), nullptr);
-            std::vector<Node<ValueType> *> internal_nodes;
+            // (weight, position in nonzeros), no weight exceeds the occurrence
+            std::vector<std::pair<ValueType, uint64_t>> leaves(nonzeros.size());
+            uint64_t weight_bits = 0;
 
             #pragma omp parallel for schedule(dynamic, 100000)
             for (uint64_t i = 0; i < nonzeros.size(); i++) {
-                leaf_nodes[i] = new LeafNode<KeyType, ValueType>{nonzeros[i], freq[nonzeros[i]]};
+                leaves[i] = {freq[nonzeros[i]], i};
             }
 
-            mergesort(leaf_nodes);
+            for (__uint128_t w = freq.count_occurrence(); w; w >>= 1) {
+                weight_bits++;
+            }
+
+            radix_sort(leaves, std::min<uint64_t>(weight_bits, sizeof (ValueType) * 8));
+
+            HuffmanTree<KeyType, ValueType> tree{leaves.size()};
+
+            #pragma omp parallel for schedule(dynamic, 100000)
+            for (uint64_t i = 0; i < leaves.size(); i++) {
+                tree.set_leaf(i, nonzeros[leaves[i].second], leaves[i].first);
+            }
 
+            // two queues: sorted leaves, and internal nodes in creation order
+            const uint64_t nleaves = leaves.size();
             uint64_t leaf_ptr = 0;
-            uint64_t internal_ptr = 0;
+            uint64_t internal_ptr = nleaves;
 
-            while ((leaf_nodes.size() - leaf_ptr) + (internal_nodes.size() - internal_ptr) > 1) {
-                Node<ValueType> *node[2];
+            while ((nleaves - leaf_ptr) + (tree.size() - internal_ptr) > 1) {
+                uint64_t node[2];
 
                 #pragma GCC unroll 2
                 for (uint32_t i = 0; i < 2; i++) {
-                    if (internal_ptr == internal_nodes.size()) [[unlikely]] {
-                        node[i] = leaf_nodes[leaf_ptr++];
+                    if (internal_ptr == tree.size()) [[unlikely]] {
+                        node[i] = leaf_ptr++;
                     }
-                    else if (leaf_ptr == leaf_nodes.size()) [[unlikely]] {
-                        node[i] = internal_nodes[internal_ptr++];
+                    else if (leaf_ptr == nleaves) [[unlikely]] {
+                        node[i] = internal_ptr++;
                     }
                     else [[likely]] {
-                        if (*leaf_nodes[leaf_ptr] < *internal_nodes[internal_ptr]) {
-                            node[i] = leaf_nodes[leaf_ptr++];
+                        if (tree.get_weight(leaf_ptr) < tree.get_weight(internal_ptr)) {
+                            node[i] = leaf_ptr++;
                         }
                         else {
-                            node[i] = internal_nodes[internal_ptr++];
+                            node[i] = internal_ptr++;
                         }
                     }
                 }
 
-                internal_nodes.push_back(new Node<ValueType>{node[0]->freq + node[1]->freq, node[0], node[1]});
-            }
-
-            Node<ValueType> *root = leaf_ptr < leaf_nodes.size() ? leaf_nodes[leaf_ptr] : internal_nodes[internal_ptr];
-
-            #pragma omp parallel
-            #pragma omp single
-            traverse(root);
-
-            #pragma omp parallel for schedule(dynamic, 100000)
-            for (uint64_t i = 0; i < leaf_nodes.size(); i++) {
-                delete leaf_nodes[i];
+                tree.add_internal(node[0], node[1]);
             }
 
-            #pragma omp parallel for schedule(dynamic, 100000)
-            for (uint64_t i = 0; i < internal_nodes.size(); i++) {
-                delete internal_nodes[i];
-            }
+            collect_code_lengths(tree);
         }
         else {
-            std::vector<Node<ValueType> *> nodes;
-            std::vector<Node<ValueType> *> free_nodes;
+            auto &nonzeros = freq.get_nonzero_elems();
 
-            for (auto &key : freq.get_nonzero_elems()) {
-                Node<ValueType> *node = new LeafNode<KeyType, ValueType>{key, freq[key]};
+            HuffmanTree<KeyType, ValueType> tree{nonzeros.size()};
+            std::vector<ValueType *> nodes(nonzeros.size());
 
-                nodes.push_back(node);
-                free_nodes.push_back(node);
+            for (uint64_t i = 0; i < nonzeros.size(); i++) {
+                tree.set_leaf(i, nonzeros[i], freq[nonzeros[i]]);
+                nodes[i] = tree.get_weight_ptr(i);
             }
 
-            MinHeap<Node<ValueType> *> heap{nodes};
+            // the heap orders pointers into the tree's weight array
+            MinHeap<ValueType *> heap{nodes};
 
             while (heap.size() > 1) {
-                Node<ValueType> *node = heap.extract();
-                Node<ValueType> *node2 = heap.extract();
-                Node<ValueType> *new_node = new Node<ValueType>{node->freq + node2->freq, node, node2};
+                uint64_t node = tree.index_of(heap.extract());
+                uint64_t node2 = tree.index_of(heap.extract());
 
-                heap.insert(new_node);
-                free_nodes.push_back(new_node);
+                heap.insert(tree.get_weight_ptr(tree.add_internal(node, node2)));
             }
 
-            Node<ValueType> *root = heap.extract();
-
-            #pragma omp parallel
-            #pragma omp single
-            traverse(root);
-
-            #pragma omp parallel for schedule(dynamic, 100000)
-            for (uint64_t i = 0; i < free_nodes.size(); i++) {
-                delete free_nodes[i];
-            }
+            collect_code_lengths(tree);
         }
     }
 
-    void traverse(Node<ValueType> *root, uint64_t codeword_length=0) {
-        if (root->left) {
-            #pragma omp task
-            traverse(root->left, codeword_length + 1);
-        }
+    void collect_code_lengths(HuffmanTree<KeyType, ValueType> &tree) {
+        tree.consume_leaf_depths([&](KeyType alphabet, ValueType weight, uint64_t depth) {
+            encoded_size += depth * weight;
+            code_lengths.push_back({alphabet, (uint8_t)depth});
+        });
+    }
 
-        if (root->right) {
-            #pragma omp task
-            traverse(root->right, codeword_length + 1);
-        }
+public:
+    ExtendedHuffman(std::span<const uint8_t> buf, uint64_t stride, uint64_t max_code_length=0) : freq(Frequency<KeyType, ValueType>{KeyType{1} << (block_form ? stride * extend_size : stride)}),
+    stride(stride), encoded_size(0), unlimited_size(0), max_code_length(max_code_length) {
+        assert(get_key_width() < sizeof (KeyType) * 8);
 
-        if (root->left == root->right) {
-            const auto &alphabet = dynamic_cast<LeafNode<KeyType, ValueType> *>(root)->tag;
-            #pragma omp critical
-            encoded_size += codeword_length * freq[alphabet];
+        if (product_form && max_code_length) {
+            throw std::invalid_argument("ExtendedHuffman: closed_form has no code lengths to limit");
         }
-    }
 
-public:
-    ExtendedHuffman(const std::vector<uint8_t> &buf, uint64_t stride) : freq(Frequency<KeyType, ValueType>{KeyType{1} << stride}),
-    stride(stride), encoded_size(0) {
         auto start_time = std::chrono::high_resolution_clock::now();
 
         build_freq(buf);
-        build_coding_table();
+
+        if constexpr (product_form) {
+            build_closed_form();
+        }
+        else {
+            build_coding_table();
+        }
+
+        unlimited_size = encoded_size;
+
+        if (max_code_length) {
+            encoded_size = limit_code_lengths<KeyType, ValueType>(code_lengths, freq, max_code_length);
+        }
 
         elapsed_time = std::chrono::high_resolution_clock::now() - start_time;
     }
 
     __uint128_t get_nonzeros() const {
+        if constexpr (product_form) {
+            return power(freq.count_nonzeros(), extend_size);
+        }
+
         return freq.count_nonzeros();
     }
 
     double get_expected_codeword_length() {
-        return 1.0 * encoded_size / freq.count_occurrence();
+        return 1.0 * encoded_size / get_occurrence();
     }
 
     double get_compression_ratio() {
-        return 1.0 * freq.count_occurrence() * stride * extend_size / encoded_size;
+        return 1.0 * get_occurrence() * stride * extend_size / encoded_size;
     }
 
     double get_execution_time() const {
         return elapsed_time.count();
     }
 
+    uint64_t get_max_codeword_length() const {
+        uint64_t longest = 0;
+
+        for (auto &[key, length] : code_lengths) {
+            longest = std::max<uint64_t>(longest, length);
+        }
+
+        return longest;
+    }
+
+    double get_length_limit_loss() const {
+        return unlimited_size ? 1.0 * encoded_size / unlimited_size - 1 : 0;
+    }
+
     __uint128_t get_occurrence() const {
+        if constexpr (product_form) {
+            return power(freq.count_occurrence(), extend_size);
+        }
+
         return freq.count_occurrence();
     }
 
@@ -242,8 +467,14 @@ public:
         std::cout << "Expected Codeword Length: " << cl     << " (bit)"      << std::endl;
         std::cout << "Compression Ratio:        " << cr                      << std::endl;
         std::cout << "Execution Time:           " << t      << " (second)"   << std::endl;
+
+        if (max_code_length) {
+            std::cout << "Max Codeword Length:      " << get_max_codeword_length()     << " (bit)" << std::endl;
+            std::cout << "Length Limit Loss:        " << get_length_limit_loss() * 100 << " (%)"   << std::endl;
+        }
     }
 
+    // the marginal's PMF in closed form, the blocks' PMF when empirical
     std::map<KeyType, double> get_PMF() {
         std::map<KeyType, double> pmf;
 
@@ -0,0 +1,263 @@
+#ifndef __FLAT_MAP_H__
+#define __FLAT_MAP_H__
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// murmur3 finalizer, every input bit affects every output bit. The high half of a
+// 128-bit key is mixed first, so keys differing only there do not collide.
+template <typename KeyType>
+inline uint64_t mix_hash(KeyType key) {
+    uint64_t h = (uint64_t)key;
+
+    if constexpr (sizeof (KeyType) > sizeof (uint64_t)) {
+        h += 0x9e3779b97f4a7c15ULL * mix_hash((uint64_t)(key >> 64));
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+// Open-addressing hash map with Robin Hood probing. Keys and values live in one
+// flat slot array, dist[i] is the probe distance of slot i plus one (0 if empty).
+// A probe stops as soon as it meets a slot closer to its home than the key would be.
+template <typename KeyType, typename ValueType>
+class FlatMap {
+    using Slot = std::pair<KeyType, ValueType>;
+
+    std::vector<Slot> slots;
+    std::vector<uint8_t> dist;
+    uint64_t mask;
+    uint64_t nelem;
+
+    static constexpr uint64_t npos = ~uint64_t{0};
+
+    uint64_t find_index(KeyType) const;
+    uint64_t insert_index(Slot);
+    void grow(uint64_t);
+
+public:
+    template <typename MapType, typename SlotType>
+    class Iterator {
+        MapType *map;
+        uint64_t idx;
+
+    public:
+        Iterator(MapType *map, uint64_t idx) : map(map), idx(idx) {
+            while (this->idx < map->dist.size() && map->dist[this->idx] == 0) this->idx++;
+        }
+
+        SlotType & operator*() const { return map->slots[idx]; }
+        SlotType * operator->() const { return &map->slots[idx]; }
+        bool operator==(const Iterator &other) const { return idx == other.idx; }
+        bool operator!=(const Iterator &other) const { return idx != other.idx; }
+
+        Iterator & operator++() {
+            do idx++; while (idx < map->dist.size() && map->dist[idx] == 0);
+            return *this;
+        }
+    };
+
+    using iterator = Iterator<FlatMap, Slot>;
+    using const_iterator = Iterator<const FlatMap, const Slot>;
+
+    FlatMap();
+    iterator find(KeyType);
+    const_iterator find(KeyType) const;
+    ValueType & operator[](KeyType);
+    uint64_t erase(KeyType);
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    uint64_t size() const;
+    bool empty() const;
+    void reserve(uint64_t);
+    void rehash(uint64_t);
+    void clear();
+};
+
+template <typename KeyType, typename ValueType>
+FlatMap<KeyType, ValueType>::FlatMap() : mask(0), nelem(0) {
+    grow(16);
+}
+
+template <typename KeyType, typename ValueType>
+inline uint64_t FlatMap<KeyType, ValueType>::find_index(KeyType key) const {
+    uint64_t idx = mix_hash(key) & mask;
+
+    for (uint8_t d = 1; dist[idx] >= d; d++) {
+        if (dist[idx] == d && slots[idx].first == key) {
+            return idx;
+        }
+
+        idx = (idx + 1) & mask;
+    }
+
+    return npos;
+}
+
+// returns the slot the inserted key ended up in
+template <typename KeyType, typename ValueType>
+uint64_t FlatMap<KeyType, ValueType>::insert_index(Slot slot) {
+    if ((nelem + 1) * 8 > dist.size() * 7) [[unlikely]] {
+        grow(dist.size() * 2);
+    }
+
+    const KeyType key = slot.first;
+    uint64_t idx = mix_hash(key) & mask;
+    uint64_t placed = npos;
+
+    for (uint8_t d = 1; ; d++) {
+        if (dist[idx] == 0) {
+            slots[idx] = std::move(slot);
+            dist[idx] = d;
+            nelem++;
+
+            return placed == npos ? idx : placed;
+        }
+
+        // steal the slot from a richer key and carry it on
+        if (dist[idx] < d) {
+            std::swap(slot, slots[idx]);
+            std::swap(d, dist[idx]);
+
+            if (placed == npos) placed = idx;
+        }
+
+        if (d == UINT8_MAX) [[unlikely]] {
+            grow(dist.size() * 2);
+            insert_index(std::move(slot));
+
+            return find_index(key);
+        }
+
+        idx = (idx + 1) & mask;
+    }
+}
+
+template <typename KeyType, typename ValueType>
+void FlatMap<KeyType, ValueType>::grow(uint64_t capacity) {
+    capacity = std::bit_ceil(std::max<uint64_t>(capacity, 16));
+
+    std::vector<Slot> old_slots(capacity);
+    std::vector<uint8_t> old_dist(capacity, 0);
+
+    std::swap(slots, old_slots);
+    std::swap(dist, old_dist);
+
+    mask = capacity - 1;
+    nelem = 0;
+
+    for (uint64_t i = 0; i < old_dist.size(); i++) {
+        if (old_dist[i]) {
+            insert_index(std::move(old_slots[i]));
+        }
+    }
+}
+
+template <typename KeyType, typename ValueType>
+typename FlatMap<KeyType, ValueType>::iterator FlatMap<KeyType, ValueType>::find(KeyType key) {
+    uint64_t idx = find_index(key);
+    return idx == npos ? end() : iterator{this, idx};
+}
+
+template <typename KeyType, typename ValueType>
+typename FlatMap<KeyType, ValueType>::const_iterator FlatMap<KeyType, ValueType>::find(KeyType key) const {
+    uint64_t idx = find_index(key);
+    return idx == npos ? end() : const_iterator{this, idx};
+}
+
+template <typename KeyType, typename ValueType>
+inline ValueType & FlatMap<KeyType, ValueType>::operator[](KeyType key) {
+    uint64_t idx = find_index(key);
+
+    if (idx == npos) {
+        idx = insert_index({key, ValueType{}});
+    }
+
+    return slots[idx].second;
+}
+
+// backward-shift deletion, the following displaced keys move one slot closer to home
+template <typename KeyType, typename ValueType>
+uint64_t FlatMap<KeyType, ValueType>::erase(KeyType key) {
+    uint64_t idx = find_index(key);
+
+    if (idx == npos) return 0;
+
+    for (uint64_t next = (idx + 1) & mask; dist[next] > 1; next = (next + 1) & mask) {
+        slots[idx] = std::move(slots[next]);
+        dist[idx] = dist[next] - 1;
+        idx = next;
+    }
+
+    dist[idx] = 0;
+    nelem--;
+
+    return 1;
+}
+
+template <typename KeyType, typename ValueType>
+typename FlatMap<KeyType, ValueType>::iterator FlatMap<KeyType, ValueType>::begin() {
+    return {this, 0};
+}
+
+template <typename KeyType, typename ValueType>
+typename FlatMap<KeyType, ValueType>::iterator FlatMap<KeyType, ValueType>::end() {
+    return {this, dist.size()};
+}
+
+template <typename KeyType, typename ValueType>
+typename FlatMap<KeyType, ValueType>::const_iterator FlatMap<KeyType, ValueType>::begin() const {
+    return {this, 0};
+}
+
+template <typename KeyType, typename ValueType>
+typename FlatMap<KeyType, ValueType>::const_iterator FlatMap<KeyType, ValueType>::end() const {
+    return {this, dist.size()};
+}
+
+template <typename KeyType, typename ValueType>
+uint64_t FlatMap<KeyType, ValueType>::size() const {
+    return nelem;
+}
+
+template <typename KeyType, typename ValueType>
+bool FlatMap<KeyType, ValueType>::empty() const {
+    return nelem == 0;
+}
+
+// room for n keys without growing
+template <typename KeyType, typename ValueType>
+void FlatMap<KeyType, ValueType>::reserve(uint64_t n) {
+    if (n * 8 > dist.size() * 7) {
+        grow(n * 8 / 7 + 1);
+    }
+}
+
+template <typename KeyType, typename ValueType>
+void FlatMap<KeyType, ValueType>::rehash(uint64_t n) {
+    if (n > dist.size()) {
+        grow(n);
+    }
+}
+
+// releases the slot array, unlike std::unordered_map::clear
+template <typename KeyType, typename ValueType>
+void FlatMap<KeyType, ValueType>::clear() {
+    slots.clear();
+    dist.clear();
+    nelem = 0;
+    grow(16);
+}
+
+#endif
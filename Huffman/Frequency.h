@@ -3,26 +3,47 @@
 
 #include <cstdint>
 #include <functional>
+#include <iostream>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "FlatMap.h"
+#include "PagedArray.h"
+
 namespace std {
 template <>
 struct hash<__uint128_t> {
     size_t operator()(const __uint128_t &val) const {
-        return std::hash<uint64_t>{}((uint64_t)val ^ (uint64_t)(val >> 64));
+        return mix_hash(val);
     }
 };
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom=10>
+inline std::ostream & operator<<(std::ostream &out, __uint128_t val) {
+    uint64_t high = (uint64_t)(val >> 64);
+    uint64_t low  = (uint64_t)val;
+    std::string str = std::to_string(low);
+
+    if (high) {
+        str += std::to_string(high);
+    }
+
+    return out << str;
+}
+
+// MapType holds the counts of sparse alphabets, std::unordered_map or FlatMap.
+// noreserve backs the dense counters with one MAP_NORESERVE mapping (PagedArray).
+template <typename KeyType, typename ValueType, uint64_t denom=10, typename MapType=std::unordered_map<KeyType, ValueType>, bool noreserve=false>
 class Frequency {
-    std::vector<ValueType> vec;
-    std::unordered_map<KeyType, ValueType> map;
+    PagedArray<ValueType, noreserve> vec;
+    MapType map;
     std::vector<KeyType> nonzero_elems;
 
-    ValueType & (Frequency<KeyType, ValueType, denom>::*access_impl)(KeyType);
-    ValueType (Frequency<KeyType, ValueType, denom>::*get_impl)(KeyType);
+    ValueType & (Frequency<KeyType, ValueType, denom, MapType, noreserve>::*access_impl)(KeyType);
+    ValueType (Frequency<KeyType, ValueType, denom, MapType, noreserve>::*get_impl)(KeyType);
 
     KeyType nelem;
     __uint128_t occurrence;
@@ -35,13 +56,16 @@ class Frequency {
 public:
     Frequency(KeyType);
     Frequency(const Frequency &);
+    Frequency(Frequency &&) = default;
     Frequency & operator=(const Frequency &);
+    Frequency & operator=(Frequency &&) = default;
     ValueType operator[](KeyType);
     ValueType & access(KeyType);
     ValueType get(KeyType);
     double get_freq(KeyType);
     void count(KeyType, __uint128_t=1);
     void count(KeyType, __uint128_t, __uint128_t);
+    void merge(Frequency &);
     KeyType size() const;
     __uint128_t count_occurrence() const;
     KeyType count_nonzeros() const;
@@ -49,8 +73,8 @@ public:
     void clear();
 };
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-ValueType & Frequency<KeyType, ValueType, denom>::__access_map(KeyType idx) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+ValueType & Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_map(KeyType idx) {
     if (map.size() < nelem / denom) [[likely]] {
         auto it = map.find(idx);
 
@@ -62,7 +86,7 @@ ValueType & Frequency<KeyType, ValueType, denom>::__access_map(KeyType idx) {
         return it->second;
     }
     else {
-        vec = std::vector<ValueType>(nelem, 0);
+        vec = PagedArray<ValueType, noreserve>(nelem);
 
         for (auto &[key, val] : map) {
             vec[key] = val;
@@ -70,15 +94,15 @@ ValueType & Frequency<KeyType, ValueType, denom>::__access_map(KeyType idx) {
 
         map.clear();
 
-        access_impl = &Frequency<KeyType, ValueType, denom>::__access_vec;
-        get_impl = &Frequency<KeyType, ValueType, denom>::__get_vec;
+        access_impl = &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_vec;
+        get_impl = &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_vec;
 
         return (this->*access_impl)(idx);
     }
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-ValueType & Frequency<KeyType, ValueType, denom>::__access_vec(KeyType idx) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+ValueType & Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_vec(KeyType idx) {
     if (vec[idx] == 0) [[unlikely]] {
         nonzero_elems.push_back(idx);
     }
@@ -86,8 +110,8 @@ ValueType & Frequency<KeyType, ValueType, denom>::__access_vec(KeyType idx) {
     return vec[idx];
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-ValueType Frequency<KeyType, ValueType, denom>::__get_map(KeyType idx) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+ValueType Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_map(KeyType idx) {
     if (map.find(idx) == map.end()) {
         return 0;
     }
@@ -96,18 +120,19 @@ ValueType Frequency<KeyType, ValueType, denom>::__get_map(KeyType idx) {
     }
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-ValueType Frequency<KeyType, ValueType, denom>::__get_vec(KeyType idx) {
-    return vec[idx];
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+ValueType Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_vec(KeyType idx) {
+    return vec.get(idx);
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-Frequency<KeyType, ValueType, denom>::Frequency(KeyType nelem) :
-    access_impl(&Frequency<KeyType, ValueType, denom>::__access_map),
-    get_impl(&Frequency<KeyType, ValueType, denom>::__get_map),
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+Frequency<KeyType, ValueType, denom, MapType, noreserve>::Frequency(KeyType nelem) :
+    access_impl(&Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_map),
+    get_impl(&Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_map),
     nelem(nelem),
     occurrence(0) {
-    if constexpr (sizeof (KeyType) >= sizeof (uint64_t)) {
+    // FlatMap rehashes in one linear pass, so it grows on demand instead
+    if constexpr (sizeof (KeyType) >= sizeof (uint64_t) && std::is_same_v<MapType, std::unordered_map<KeyType, ValueType>>) {
         if (nelem > KeyType{1} << 52) {
             map.reserve(25000000);
             map.rehash(25000000);
@@ -123,84 +148,99 @@ Frequency<KeyType, ValueType, denom>::Frequency(KeyType nelem) :
     }
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-Frequency<KeyType, ValueType, denom>::Frequency(const Frequency &other) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+Frequency<KeyType, ValueType, denom, MapType, noreserve>::Frequency(const Frequency &other) {
     vec = other.vec;
     map = other.map;
     nonzero_elems = other.nonzero_elems;
-    access_impl = other.access_impl == &Frequency<KeyType, ValueType, denom>::__access_map ? &Frequency<KeyType, ValueType, denom>::__access_map : &Frequency<KeyType, ValueType, denom>::__access_vec;
-    get_impl = other.get_impl == &Frequency<KeyType, ValueType, denom>::__get_map ? &Frequency<KeyType, ValueType, denom>::__get_map : &Frequency<KeyType, ValueType, denom>::__get_vec;
+    access_impl = other.access_impl == &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_map ? &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_map : &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_vec;
+    get_impl = other.get_impl == &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_map ? &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_map : &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_vec;
     nelem = other.nelem;
     occurrence = other.occurrence;
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-Frequency<KeyType, ValueType, denom> & Frequency<KeyType, ValueType, denom>::operator=(const Frequency &other) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+Frequency<KeyType, ValueType, denom, MapType, noreserve> & Frequency<KeyType, ValueType, denom, MapType, noreserve>::operator=(const Frequency &other) {
     vec = other.vec;
     map = other.map;
     nonzero_elems = other.nonzero_elems;
-    access_impl = other.access_impl == &Frequency<KeyType, ValueType, denom>::__access_map ? &Frequency<KeyType, ValueType, denom>::__access_map : &Frequency<KeyType, ValueType, denom>::__access_vec;
-    get_impl = other.get_impl == &Frequency<KeyType, ValueType, denom>::__get_map ? &Frequency<KeyType, ValueType, denom>::__get_map : &Frequency<KeyType, ValueType, denom>::__get_vec;
+    access_impl = other.access_impl == &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_map ? &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_map : &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__access_vec;
+    get_impl = other.get_impl == &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_map ? &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_map : &Frequency<KeyType, ValueType, denom, MapType, noreserve>::__get_vec;
     nelem = other.nelem;
     occurrence = other.occurrence;
 
     return *this;
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-ValueType Frequency<KeyType, ValueType, denom>::operator[](KeyType idx) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+ValueType Frequency<KeyType, ValueType, denom, MapType, noreserve>::operator[](KeyType idx) {
     return get(idx);
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-ValueType & Frequency<KeyType, ValueType, denom>::access(KeyType idx) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+ValueType & Frequency<KeyType, ValueType, denom, MapType, noreserve>::access(KeyType idx) {
     return (this->*access_impl)(idx);
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-ValueType Frequency<KeyType, ValueType, denom>::get(KeyType idx) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+ValueType Frequency<KeyType, ValueType, denom, MapType, noreserve>::get(KeyType idx) {
     return (this->*get_impl)(idx);
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-double Frequency<KeyType, ValueType, denom>::get_freq(KeyType idx) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+double Frequency<KeyType, ValueType, denom, MapType, noreserve>::get_freq(KeyType idx) {
     return 1.0 * get(idx) / occurrence;
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-void Frequency<KeyType, ValueType, denom>::count(KeyType idx, __uint128_t amount) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+void Frequency<KeyType, ValueType, denom, MapType, noreserve>::count(KeyType idx, __uint128_t amount) {
     access(idx) += amount;
     occurrence += amount;
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-void Frequency<KeyType, ValueType, denom>::count(KeyType idx, __uint128_t amount, __uint128_t occ_amount) {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+void Frequency<KeyType, ValueType, denom, MapType, noreserve>::count(KeyType idx, __uint128_t amount, __uint128_t occ_amount) {
     access(idx) += amount;
     occurrence += occ_amount;
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-KeyType Frequency<KeyType, ValueType, denom>::size() const {
+// adds other into this and clears other, the smaller table is folded into the larger one
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+void Frequency<KeyType, ValueType, denom, MapType, noreserve>::merge(Frequency &other) {
+    if (other.count_nonzeros() > count_nonzeros()) {
+        std::swap(*this, other);
+    }
+
+    for (auto &key : other.nonzero_elems) {
+        count(key, other.get(key), 0);
+    }
+
+    occurrence += other.occurrence;
+    other.clear();
+}
+
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+KeyType Frequency<KeyType, ValueType, denom, MapType, noreserve>::size() const {
     return nelem;
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-__uint128_t Frequency<KeyType, ValueType, denom>::count_occurrence() const {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+__uint128_t Frequency<KeyType, ValueType, denom, MapType, noreserve>::count_occurrence() const {
     return occurrence;
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-KeyType Frequency<KeyType, ValueType, denom>::count_nonzeros() const {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+KeyType Frequency<KeyType, ValueType, denom, MapType, noreserve>::count_nonzeros() const {
     return nonzero_elems.size();
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-std::vector<KeyType> & Frequency<KeyType, ValueType, denom>::get_nonzero_elems() {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+std::vector<KeyType> & Frequency<KeyType, ValueType, denom, MapType, noreserve>::get_nonzero_elems() {
     return nonzero_elems;
 }
 
-template <typename KeyType, typename ValueType, uint64_t denom>
-void Frequency<KeyType, ValueType, denom>::clear() {
+template <typename KeyType, typename ValueType, uint64_t denom, typename MapType, bool noreserve>
+void Frequency<KeyType, ValueType, denom, MapType, noreserve>::clear() {
     vec.clear();
     map.clear();
     nonzero_elems.clear();
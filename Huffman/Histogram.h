@@ -0,0 +1,112 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Histogram kernels for 8 and 16-bit symbols. Consecutive symbols go to
+// different counter banks, so repeated symbols do not serialize on the
+// store-to-load forwarding of a single counter. Banks are 32-bit and get
+// reduced into the 64-bit counts every block.
+constexpr uint64_t histogram_block_size = uint64_t{1} << 30;
+
+inline uint64_t load_le_word(const uint8_t *data) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof (uint64_t));
+
+    if constexpr (std::endian::native == std::endian::big) {
+        word = __builtin_bswap64(word);
+    }
+
+    return word;
+}
+
+// counts[i] += sum of banks[b][i]
+inline void reduce_banks(std::vector<uint32_t> &banks, uint64_t nbanks, uint64_t nelem, uint64_t *counts) {
+    for (uint64_t i = 0; i < nelem; i++) {
+        uint64_t sum = 0;
+
+        for (uint64_t b = 0; b < nbanks; b++) {
+            sum += banks[b*nelem + i];
+        }
+
+        counts[i] += sum;
+    }
+
+    std::fill(banks.begin(), banks.end(), 0);
+}
+
+// counts must hold 256 elements
+inline void histogram_8(const uint8_t *data, uint64_t n, uint64_t *counts) {
+    constexpr uint64_t nbanks = 8;
+    constexpr uint64_t nelem = 256;
+
+    std::vector<uint32_t> banks(nbanks * nelem, 0);
+    uint32_t *bank[nbanks];
+
+    for (uint64_t b = 0; b < nbanks; b++) {
+        bank[b] = banks.data() + b*nelem;
+    }
+
+    for (uint64_t begin = 0; begin < n; begin += histogram_block_size) {
+        const uint64_t end = std::min(n, begin + histogram_block_size);
+        uint64_t i = begin;
+
+        for (; i + 8 <= end; i += 8) {
+            uint64_t word = load_le_word(data + i);
+
+            #pragma GCC unroll 8
+            for (uint64_t b = 0; b < nbanks; b++) {
+                bank[b][(word >> (8*b)) & 0xff]++;
+            }
+        }
+
+        for (; i < end; i++) {
+            bank[0][data[i]]++;
+        }
+
+        reduce_banks(banks, nbanks, nelem, counts);
+    }
+}
+
+// counts must hold 65536 elements, symbols are big-endian and an odd tail byte is zero-padded
+inline void histogram_16(const uint8_t *data, uint64_t n, uint64_t *counts) {
+    constexpr uint64_t nbanks = 4;
+    constexpr uint64_t nelem = 65536;
+
+    std::vector<uint32_t> banks(nbanks * nelem, 0);
+    uint32_t *bank[nbanks];
+
+    for (uint64_t b = 0; b < nbanks; b++) {
+        bank[b] = banks.data() + b*nelem;
+    }
+
+    for (uint64_t begin = 0; begin < n; begin += histogram_block_size) {
+        const uint64_t end = std::min(n, begin + histogram_block_size);
+        uint64_t i = begin;
+
+        for (; i + 8 <= end; i += 8) {
+            uint64_t word = __builtin_bswap64(load_le_word(data + i));
+
+            #pragma GCC unroll 4
+            for (uint64_t b = 0; b < nbanks; b++) {
+                bank[b][(word >> (48 - 16*b)) & 0xffff]++;
+            }
+        }
+
+        for (; i + 2 <= end; i += 2) {
+            bank[0][(uint64_t)data[i] << 8 | data[i + 1]]++;
+        }
+
+        if (i < end) {
+            bank[0][(uint64_t)data[i] << 8]++;
+        }
+
+        reduce_banks(banks, nbanks, nelem, counts);
+    }
+}
+
+#endif
@@ -10,196 +10,316 @@
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <span>
 #include <string>
 #include <type_traits>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "AlphabetStream.h"
+#include "BitWriter.h"
+#include "CanonicalCode.h"
+#include "ChunkedReader.h"
+#include "CodeLength.h"
 #include "Frequency.h"
-#include "MergeSort.h"
+#include "Histogram.h"
+#include "HuffmanDecoder.h"
+#include "HuffmanTree.h"
 #include "MinHeap.h"
-#include "Node.h"
-
-inline std::ostream & operator<<(std::ostream &out, __uint128_t val) {
-    uint64_t high = (uint64_t)(val >> 64);
-    uint64_t low  = (uint64_t)val;
-    std::string str = std::to_string(low);
-
-    if (high) {
-        str += std::to_string(high);
-    }
-
-    return out << str;
-}
+#include "RadixSort.h"
 
-template <typename KeyType, typename ValueType, bool par_read=false, bool par_build=false>
+template <typename KeyType, typename ValueType, bool par_read=false, bool par_build=false, bool in_place=false, typename FreqType=Frequency<KeyType, ValueType>>
 class Huffman {
-    Frequency<KeyType, ValueType> freq;
+    FreqType freq;
+    std::vector<FreqType> local_freq;
     uint64_t stride;
     std::chrono::duration<double> elapsed_time;
     uint64_t encoded_size;
+    uint64_t unlimited_size;
+    uint64_t max_code_length;
+
+    std::vector<std::pair<KeyType, uint8_t>> code_lengths;
+    CanonicalCode<KeyType> code;
+
+    std::chrono::duration<double> encode_time;
+    std::chrono::duration<double> decode_time;
+    uint64_t input_bytes;
+    uint64_t output_bytes;
+    uint64_t decoded_bytes;
+
+    void build_small_freq(std::span<const uint8_t> buf) {
+        std::vector<uint64_t> counts(uint64_t{1} << stride, 0);
+        auto histogram = stride == 8 ? histogram_8 : histogram_16;
 
-    void build_freq(const std::vector<uint8_t> &buf) {
         if constexpr (par_read) {
-            uint64_t lcm = std::lcm(8, stride);
-            uint64_t step = lcm * (1 * 1024 * 1024 / lcm);
+            uint64_t nthreads = 1;
 
-            #pragma omp parallel for schedule(dynamic, 1)
-            for (uint64_t i = 0; i < buf.size() / step; i++) {
-                std::vector<uint8_t>::const_iterator start = buf.begin() + i*step;
-                std::vector<uint8_t>::const_iterator end = buf.begin() + (i + 1)*step;
+            #ifdef _OPENMP
+            nthreads = omp_get_max_threads();
+            #endif
+
+            uint64_t step = std::max<uint64_t>(1 * 1024 * 1024, (buf.size() / (4 * nthreads) + 1) & ~uint64_t{1});
+            uint64_t nchunks = (buf.size() + step - 1) / step;
 
-                std::vector<uint8_t> sub_buf{start, end};
-                AlphabetStream<KeyType> data{{sub_buf}, stride};
-                Frequency<KeyType, ValueType> temp{KeyType{1} << stride};
+            #pragma omp parallel
+            {
+                std::vector<uint64_t> local(counts.size(), 0);
 
-                for (uint64_t j = 0; j < step * 8 / stride; j++) {
-                    temp.count(data.next());
+                #pragma omp for schedule(dynamic, 1) nowait
+                for (uint64_t i = 0; i < nchunks; i++) {
+                    histogram(buf.data() + i*step, std::min(step, buf.size() - i*step), local.data());
                 }
 
                 #pragma omp critical
-                for (auto &a : temp.get_nonzero_elems()) {
-                    freq.count(a, temp[a]);
+                for (uint64_t k = 0; k < counts.size(); k++) {
+                    counts[k] += local[k];
                 }
             }
+        }
+        else {
+            histogram(buf.data(), buf.size(), counts.data());
+        }
 
-            if (buf.size() / step * step < buf.size()) {
-                std::vector<uint8_t>::const_iterator start = buf.begin() + (buf.size() / step * step);
-                std::vector<uint8_t>::const_iterator end = buf.begin() + buf.size();
+        for (uint64_t k = 0; k < counts.size(); k++) {
+            if (counts[k]) {
+                freq.count(k, counts[k]);
+            }
+        }
+    }
 
-                std::vector<uint8_t> sub_buf{start, end};
-                AlphabetStream<KeyType> data{sub_buf, stride};
+    void build_freq(std::span<const uint8_t> buf) {
+        if (sizeof (KeyType) * 8 >= stride && (stride == 8 || stride == 16)) {
+            build_small_freq(buf);
+            return;
+        }
 
-                while (!data.empty()) {
-                    freq.count(data.next());
+        if constexpr (par_read) {
+            uint64_t lcm = std::lcm(8, stride);
+            uint64_t step = lcm * (1 * 1024 * 1024 / lcm);
+
+            uint64_t nchunks = (buf.size() + step - 1) / step;
+
+            if (local_freq.empty()) {
+                uint64_t nthreads = 1;
+
+                #ifdef _OPENMP
+                nthreads = omp_get_max_threads();
+                #endif
+
+                local_freq.reserve(nthreads);
+
+                for (uint64_t t = 0; t < nthreads; t++) {
+                    local_freq.emplace_back(KeyType{1} << stride);
                 }
             }
-        }
-        else {
-            AlphabetStream<KeyType> data{buf, stride};
 
-            while (!data.empty()) {
-                freq.count(data.next());
+            #pragma omp parallel
+            {
+                uint64_t tid = 0;
+
+                #ifdef _OPENMP
+                tid = omp_get_thread_num();
+                #endif
+
+                #pragma omp for schedule(dynamic, 1)
+                for (uint64_t i = 0; i < nchunks; i++) {
+                    for_each_alphabet<KeyType>(buf.subspan(i*step, std::min(step, buf.size() - i*step)), stride, [&](KeyType alphabet) {
+                        local_freq[tid].count(alphabet);
+                    });
+                }
             }
         }
+        else {
+            for_each_alphabet<KeyType>(buf, stride, [&](KeyType alphabet) {
+                freq.count(alphabet);
+            });
+        }
     }
 
     void build_coding_table() {
-        if constexpr (par_build) {
-            auto nonzeros = freq.get_nonzero_elems();
+        code_lengths.resize(freq.count_nonzeros());
+
+        if constexpr (in_place) {
+            auto &nonzeros = freq.get_nonzero_elems();
 
-            std::vector<Node<ValueType> *> leaf_nodes(nonzeros.size(), nullptr);
-            std::vector<Node<ValueType> *> internal_nodes;
+            std::vector<std::pair<ValueType, KeyType>> leaves(nonzeros.size());
+            std::vector<ValueType> weights(nonzeros.size());
+
+            for (uint64_t i = 0; i < nonzeros.size(); i++) {
+                leaves[i] = {freq[nonzeros[i]], nonzeros[i]};
+            }
+
+            std::sort(leaves.begin(), leaves.end(), [](const auto &lhs, const auto &rhs) {
+                return lhs.first < rhs.first;
+            });
+
+            for (uint64_t i = 0; i < leaves.size(); i++) {
+                weights[i] = leaves[i].first;
+            }
+
+            encoded_size = in_place_code_lengths(weights);
+
+            for (uint64_t i = 0; i < leaves.size(); i++) {
+                code_lengths[i] = {leaves[i].second, (uint8_t)weights[i]};
+            }
+        }
+        else if constexpr (par_build) {
+            auto &nonzeros = freq.get_nonzero_elems();
+
+            // (weight, position in nonzeros), no weight exceeds the occurrence
+            std::vector<std::pair<ValueType, uint64_t>> leaves(nonzeros.size());
+            uint64_t weight_bits = 0;
 
             #pragma omp parallel for schedule(dynamic, 100000)
             for (uint64_t i = 0; i < nonzeros.size(); i++) {
-                leaf_nodes[i] = new LeafNode<KeyType, ValueType>{nonzeros[i], freq[nonzeros[i]]};
+                leaves[i] = {freq[nonzeros[i]], i};
+            }
+
+            for (__uint128_t w = freq.count_occurrence(); w; w >>= 1) {
+                weight_bits++;
             }
 
-            mergesort(leaf_nodes);
+            radix_sort(leaves, std::min<uint64_t>(weight_bits, sizeof (ValueType) * 8));
+
+            HuffmanTree<KeyType, ValueType> tree{leaves.size()};
+
+            #pragma omp parallel for schedule(dynamic, 100000)
+            for (uint64_t i = 0; i < leaves.size(); i++) {
+                tree.set_leaf(i, nonzeros[leaves[i].second], leaves[i].first);
+            }
 
+            // two queues: sorted leaves, and internal nodes in creation order
+            const uint64_t nleaves = leaves.size();
             uint64_t leaf_ptr = 0;
-            uint64_t internal_ptr = 0;
+            uint64_t internal_ptr = nleaves;
 
-            while ((leaf_nodes.size() - leaf_ptr) + (internal_nodes.size() - internal_ptr) > 1) {
-                Node<ValueType> *node[2];
+            while ((nleaves - leaf_ptr) + (tree.size() - internal_ptr) > 1) {
+                uint64_t node[2];
 
                 #pragma GCC unroll 2
                 for (uint32_t i = 0; i < 2; i++) {
-                    if (internal_ptr == internal_nodes.size()) [[unlikely]] {
-                        node[i] = leaf_nodes[leaf_ptr++];
+                    if (internal_ptr == tree.size()) [[unlikely]] {
+                        node[i] = leaf_ptr++;
                     }
-                    else if (leaf_ptr == leaf_nodes.size()) [[unlikely]] {
-                        node[i] = internal_nodes[internal_ptr++];
+                    else if (leaf_ptr == nleaves) [[unlikely]] {
+                        node[i] = internal_ptr++;
                     }
                     else [[likely]] {
-                        if (*leaf_nodes[leaf_ptr] < *internal_nodes[internal_ptr]) {
-                            node[i] = leaf_nodes[leaf_ptr++];
+                        if (tree.get_weight(leaf_ptr) < tree.get_weight(internal_ptr)) {
+                            node[i] = leaf_ptr++;
                         }
                         else {
-                            node[i] = internal_nodes[internal_ptr++];
+                            node[i] = internal_ptr++;
                         }
                     }
                 }
 
-                internal_nodes.push_back(new Node<ValueType>{node[0]->freq + node[1]->freq, node[0], node[1]});
-            }
-
-            Node<ValueType> *root = leaf_ptr < leaf_nodes.size() ? leaf_nodes[leaf_ptr] : internal_nodes[internal_ptr];
-
-            #pragma omp parallel
-            #pragma omp single
-            traverse(root);
-
-            #pragma omp parallel for schedule(dynamic, 100000)
-            for (uint64_t i = 0; i < leaf_nodes.size(); i++) {
-                delete leaf_nodes[i];
+                tree.add_internal(node[0], node[1]);
             }
 
-            #pragma omp parallel for schedule(dynamic, 100000)
-            for (uint64_t i = 0; i < internal_nodes.size(); i++) {
-                delete internal_nodes[i];
-            }
+            collect_code_lengths(tree);
         }
         else {
-            std::vector<Node<ValueType> *> nodes;
-            std::vector<Node<ValueType> *> free_nodes;
+            auto &nonzeros = freq.get_nonzero_elems();
 
-            for (auto &key : freq.get_nonzero_elems()) {
-                Node<ValueType> *node = new LeafNode<KeyType, ValueType>{key, freq[key]};
+            HuffmanTree<KeyType, ValueType> tree{nonzeros.size()};
+            std::vector<ValueType *> nodes(nonzeros.size());
 
-                nodes.push_back(node);
-                free_nodes.push_back(node);
+            for (uint64_t i = 0; i < nonzeros.size(); i++) {
+                tree.set_leaf(i, nonzeros[i], freq[nonzeros[i]]);
+                nodes[i] = tree.get_weight_ptr(i);
             }
 
-            MinHeap<Node<ValueType> *> heap{nodes};
+            // the heap orders pointers into the tree's weight array
+            MinHeap<ValueType *> heap{nodes};
 
             while (heap.size() > 1) {
-                Node<ValueType> *node = heap.extract();
-                Node<ValueType> *node2 = heap.extract();
-                Node<ValueType> *new_node = new Node<ValueType>{node->freq + node2->freq, node, node2};
+                uint64_t node = tree.index_of(heap.extract());
+                uint64_t node2 = tree.index_of(heap.extract());
 
-                heap.insert(new_node);
-                free_nodes.push_back(new_node);
+                heap.insert(tree.get_weight_ptr(tree.add_internal(node, node2)));
             }
 
-            Node<ValueType> *root = heap.extract();
+            collect_code_lengths(tree);
+        }
+    }
 
-            #pragma omp parallel
-            #pragma omp single
-            traverse(root);
+    void collect_code_lengths(HuffmanTree<KeyType, ValueType> &tree) {
+        uint64_t i = 0;
 
-            #pragma omp parallel for schedule(dynamic, 100000)
-            for (uint64_t i = 0; i < free_nodes.size(); i++) {
-                delete free_nodes[i];
-            }
-        }
+        tree.consume_leaf_depths([&](KeyType alphabet, ValueType weight, uint64_t depth) {
+            encoded_size += depth * weight;
+            code_lengths[i++] = {alphabet, (uint8_t)depth};
+        });
     }
 
-    void traverse(Node<ValueType> *root, uint64_t codeword_length=0) {
-        if (root->left) {
-            #pragma omp task
-            traverse(root->left, codeword_length + 1);
+    // pairwise tree reduction of the per-thread tables, log2(nthreads) rounds without locking
+    void merge_local_freq() {
+        uint64_t nthreads = local_freq.size();
+
+        for (uint64_t gap = 1; gap < nthreads; gap *= 2) {
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (uint64_t t = 0; t < nthreads - gap; t += 2*gap) {
+                local_freq[t].merge(local_freq[t + gap]);
+            }
         }
 
-        if (root->right) {
-            #pragma omp task
-            traverse(root->right, codeword_length + 1);
+        if (nthreads) {
+            freq.merge(local_freq[0]);
+            local_freq.clear();
         }
+    }
+
+    void build_code() {
+        merge_local_freq();
+        build_coding_table();
 
-        if (root->left == root->right) {
-            const auto &alphabet = dynamic_cast<LeafNode<KeyType, ValueType> *>(root)->tag;
+        unlimited_size = encoded_size;
 
-            __sync_fetch_and_add(&encoded_size, codeword_length * freq[alphabet]);
+        if (max_code_length) {
+            encoded_size = limit_code_lengths<KeyType, ValueType>(code_lengths, freq, max_code_length);
         }
     }
 
 public:
-    Huffman(const std::vector<uint8_t> &buf, uint64_t stride) : freq(Frequency<KeyType, ValueType>{KeyType{1} << stride}),
-    stride(stride), encoded_size(0) {
+    Huffman(std::span<const uint8_t> buf, uint64_t stride, uint64_t max_code_length=0) : freq(FreqType{KeyType{1} << stride}),
+    stride(stride), encoded_size(0), unlimited_size(0), max_code_length(max_code_length), encode_time(0), decode_time(0), input_bytes(0), output_bytes(0), decoded_bytes(0) {
         auto start_time = std::chrono::high_resolution_clock::now();
 
         build_freq(buf);
-        build_coding_table();
+        build_code();
+
+        elapsed_time = std::chrono::high_resolution_clock::now() - start_time;
+    }
+
+    // streams the input through the reader's buffer, memory use is bounded by the chunk size and the tables
+    Huffman(ChunkedReader &reader, uint64_t max_code_length=0) : freq(FreqType{KeyType{1} << reader.get_stride()}),
+    stride(reader.get_stride()), encoded_size(0), unlimited_size(0), max_code_length(max_code_length), encode_time(0), decode_time(0), input_bytes(0), output_bytes(0), decoded_bytes(0) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        for (auto chunk = reader.next(); !chunk.empty(); chunk = reader.next()) {
+            build_freq(chunk);
+        }
+
+        // a failed read leaves the counts truncated, the caller checks reader.fail()
+        if (reader.fail()) {
+            elapsed_time = std::chrono::high_resolution_clock::now() - start_time;
+            return;
+        }
+
+        build_code();
+
+        elapsed_time = std::chrono::high_resolution_clock::now() - start_time;
+    }
+
+    // codes statistics counted elsewhere, e.g. a window merged from a ChunkIndex
+    Huffman(FreqType &&freq, uint64_t stride, uint64_t max_code_length=0) : freq(std::move(freq)),
+    stride(stride), encoded_size(0), unlimited_size(0), max_code_length(max_code_length), encode_time(0), decode_time(0), input_bytes(0), output_bytes(0), decoded_bytes(0) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        build_code();
 
         elapsed_time = std::chrono::high_resolution_clock::now() - start_time;
     }
@@ -220,10 +340,148 @@ public:
         return elapsed_time.count();
     }
 
+    uint64_t get_max_codeword_length() const {
+        uint64_t longest = 0;
+
+        for (auto &[key, length] : code_lengths) {
+            longest = std::max<uint64_t>(longest, length);
+        }
+
+        return longest;
+    }
+
+    double get_length_limit_loss() const {
+        return unlimited_size ? 1.0 * encoded_size / unlimited_size - 1 : 0;
+    }
+
     __uint128_t get_occurrence() const {
         return freq.count_occurrence();
     }
 
+    const CanonicalCode<KeyType> & get_code() {
+        if (code.size() != code_lengths.size()) [[unlikely]] {
+            code = CanonicalCode<KeyType>{code_lengths, stride};
+        }
+
+        return code;
+    }
+
+    std::vector<uint8_t> encode(std::span<const uint8_t> buf) {
+        get_code();
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        BitWriter writer{encoded_size / 8};
+
+        for_each_alphabet<KeyType>(buf, stride, [&](KeyType alphabet) {
+            uint64_t idx = code.find(alphabet);
+            writer.write(code.get_code(idx), code.get_length(idx));
+        });
+
+        std::vector<uint8_t> bits = writer.flush();
+
+        encode_time = std::chrono::high_resolution_clock::now() - start_time;
+        input_bytes = buf.size();
+        output_bytes = bits.size();
+
+        return bits;
+    }
+
+    // same code lengths, symbols dealt round-robin to nstreams independent bitstreams
+    template <uint64_t nstreams=4>
+    std::vector<uint8_t> encode_interleaved(std::span<const uint8_t> buf) {
+        get_code();
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        std::vector<BitWriter> writers;
+        uint64_t s = 0;
+
+        writers.reserve(nstreams);
+
+        for (uint64_t i = 0; i < nstreams; i++) {
+            writers.emplace_back(encoded_size / 8 / nstreams);
+        }
+
+        for_each_alphabet<KeyType>(buf, stride, [&](KeyType alphabet) {
+            uint64_t idx = code.find(alphabet);
+            writers[s].write(code.get_code(idx), code.get_length(idx));
+            s = s + 1 == nstreams ? 0 : s + 1;
+        });
+
+        std::vector<uint8_t> bits(nstreams * sizeof (uint64_t));
+
+        for (uint64_t i = 0; i < nstreams; i++) {
+            std::vector<uint8_t> stream = writers[i].flush();
+
+            store_stream_size(bits, i, stream.size());
+            bits.insert(bits.end(), stream.begin(), stream.end());
+        }
+
+        encode_time = std::chrono::high_resolution_clock::now() - start_time;
+        input_bytes = buf.size();
+        output_bytes = bits.size();
+
+        return bits;
+    }
+
+    template <uint64_t nstreams=4>
+    std::vector<uint8_t> decode_interleaved(const std::vector<uint8_t> &bits, uint64_t nbytes, uint64_t root_bits=11) {
+        HuffmanDecoder<KeyType> decoder{get_code(), root_bits};
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        std::vector<uint8_t> buf = decoder.template decode_interleaved<nstreams>(bits, freq.count_occurrence(), nbytes);
+
+        decode_time = std::chrono::high_resolution_clock::now() - start_time;
+        decoded_bytes = nbytes;
+
+        return buf;
+    }
+
+    std::vector<uint8_t> decode(const std::vector<uint8_t> &bits, uint64_t nbytes, uint64_t root_bits=11) {
+        HuffmanDecoder<KeyType> decoder{get_code(), root_bits};
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        std::vector<uint8_t> buf = decoder.decode(bits, freq.count_occurrence(), nbytes);
+
+        decode_time = std::chrono::high_resolution_clock::now() - start_time;
+        decoded_bytes = nbytes;
+
+        return buf;
+    }
+
+    // same stream, decoded on all threads by resynchronizing speculative chunks
+    std::vector<uint8_t> parallel_decode(const std::vector<uint8_t> &bits, uint64_t nbytes, uint64_t root_bits=11, uint64_t chunk_bits=0) {
+        HuffmanDecoder<KeyType> decoder{get_code(), root_bits};
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        std::vector<uint8_t> buf = decoder.decode_parallel(bits, freq.count_occurrence(), nbytes, chunk_bits);
+
+        decode_time = std::chrono::high_resolution_clock::now() - start_time;
+        decoded_bytes = nbytes;
+
+        return buf;
+    }
+
+    double get_encode_time() const {
+        return encode_time.count();
+    }
+
+    double get_encode_throughput() const {
+        return input_bytes / (1024.0 * 1024.0) / encode_time.count();
+    }
+
+    double get_decode_time() const {
+        return decode_time.count();
+    }
+
+    double get_decode_throughput() const {
+        return decoded_bytes / (1024.0 * 1024.0) / decode_time.count();
+    }
+
     void dump() {
         auto n  = get_nonzeros();
         auto o  = get_occurrence();
@@ -237,6 +495,20 @@ public:
         std::cout << "Expected Codeword Length: " << cl     << " (bit)"      << std::endl;
         std::cout << "Compression Ratio:        " << cr                      << std::endl;
         std::cout << "Execution Time:           " << t      << " (second)"   << std::endl;
+
+        if (max_code_length) {
+            std::cout << "Max Codeword Length:      " << get_max_codeword_length()     << " (bit)" << std::endl;
+            std::cout << "Length Limit Loss:        " << get_length_limit_loss() * 100 << " (%)"   << std::endl;
+        }
+
+        if (input_bytes) {
+            std::cout << "Encoded Size:             " << output_bytes            << " (byte)" << std::endl;
+            std::cout << "Encode Throughput:        " << get_encode_throughput() << " (MB/s)" << std::endl;
+        }
+
+        if (decoded_bytes) {
+            std::cout << "Decode Throughput:        " << get_decode_throughput() << " (MB/s)" << std::endl;
+        }
     }
 
     std::map<KeyType, double> get_PMF() {
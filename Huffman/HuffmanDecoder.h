@@ -0,0 +1,456 @@
+#ifndef __HUFFMAN_DECODER_H__
+#define __HUFFMAN_DECODER_H__
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "BitReader.h"
+#include "BitWriter.h"
+#include "CanonicalCode.h"
+
+// Multi-level lookup table decoder: the primary table is indexed by the next
+// root_bits bits, longer codewords chain into secondary tables of at most
+// root_bits bits each.
+template <typename KeyType>
+class HuffmanDecoder {
+    struct Entry {
+        uint32_t value;     // symbol index, or table offset if link
+        uint8_t bits;       // bits consumed by the symbol, or index width of the linked table
+        uint8_t link;
+    };
+
+    std::vector<KeyType> symbols;
+    std::vector<Entry> table;
+    uint64_t root_bits;
+    uint64_t stride;
+
+    void build_table(const CanonicalCode<KeyType> &, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t);
+    void skip_symbol(BitReader &) const;
+
+public:
+    HuffmanDecoder(const CanonicalCode<KeyType> &, uint64_t=11);
+    uint64_t decode_index(BitReader &) const;
+    KeyType decode_symbol(BitReader &) const;
+    KeyType get_symbol(uint64_t) const;
+    std::vector<uint8_t> decode(const std::vector<uint8_t> &, uint64_t, uint64_t) const;
+    std::vector<uint8_t> decode_parallel(const std::vector<uint8_t> &, uint64_t, uint64_t, uint64_t=0) const;
+    template <uint64_t nstreams> std::vector<uint8_t> decode_interleaved(const std::vector<uint8_t> &, uint64_t, uint64_t) const;
+    uint64_t get_root_bits() const;
+    uint64_t get_table_size() const;
+};
+
+// Interleaved streams start with nstreams little-endian u64 byte sizes, then the
+// streams back to back. Symbol i goes to stream i % nstreams.
+inline void store_stream_size(std::vector<uint8_t> &bits, uint64_t idx, uint64_t size) {
+    if constexpr (std::endian::native == std::endian::big) {
+        size = __builtin_bswap64(size);
+    }
+
+    std::memcpy(bits.data() + idx * sizeof (uint64_t), &size, sizeof (uint64_t));
+}
+
+inline uint64_t load_stream_size(const std::vector<uint8_t> &bits, uint64_t idx) {
+    uint64_t size;
+    std::memcpy(&size, bits.data() + idx * sizeof (uint64_t), sizeof (uint64_t));
+
+    if constexpr (std::endian::native == std::endian::big) {
+        size = __builtin_bswap64(size);
+    }
+
+    return size;
+}
+
+template <typename KeyType>
+void write_symbol(BitWriter &writer, KeyType symbol, uint64_t stride) {
+    if constexpr (sizeof (KeyType) > sizeof (uint64_t)) {
+        if (stride > 64) {
+            writer.write((uint64_t)(symbol >> 64), stride - 64);
+            writer.write((uint64_t)symbol, 64);
+            return;
+        }
+    }
+
+    writer.write((uint64_t)symbol, stride);
+}
+
+// counterpart of write_symbol, wide symbols take several reads of at most 56 bits
+template <typename KeyType>
+KeyType read_symbol(BitReader &reader, uint64_t stride) {
+    KeyType symbol = 0;
+    uint64_t left = stride;
+
+    if constexpr (sizeof (KeyType) * 8 > 56) {
+        while (left > 56) {
+            symbol = (symbol << 56) | reader.read(56);
+            left -= 56;
+        }
+    }
+
+    return (symbol << left) | reader.read(left);
+}
+
+// fills the table at offset with the codewords [lo, hi), which share their first consumed bits
+template <typename KeyType>
+void HuffmanDecoder<KeyType>::build_table(const CanonicalCode<KeyType> &code, uint64_t offset, uint64_t bits, uint64_t consumed, uint64_t lo, uint64_t hi) {
+    auto suffix = [&](uint64_t i) {
+        uint64_t rest = code.get_length(i) - consumed;
+        return rest == 64 ? code.get_code(i) : code.get_code(i) & ((uint64_t{1} << rest) - 1);
+    };
+
+    for (uint64_t i = lo; i < hi; ) {
+        uint64_t rest = code.get_length(i) - consumed;
+
+        if (rest <= bits) {
+            uint64_t start = suffix(i) << (bits - rest);
+
+            for (uint64_t j = 0; j < (uint64_t{1} << (bits - rest)); j++) {
+                table[offset + start + j] = {(uint32_t)i, (uint8_t)rest, 0};
+            }
+
+            i++;
+        }
+        else {
+            uint64_t prefix = suffix(i) >> (rest - bits);
+            uint64_t longest = rest;
+            uint64_t k = i + 1;
+
+            while (k < hi && (suffix(k) >> (code.get_length(k) - consumed - bits)) == prefix) {
+                longest = code.get_length(k) - consumed;
+                k++;
+            }
+
+            uint64_t sub_bits = std::min(longest - bits, root_bits);
+            uint64_t sub_offset = table.size();
+
+            table.resize(sub_offset + (uint64_t{1} << sub_bits));
+            table[offset + prefix] = {(uint32_t)sub_offset, (uint8_t)sub_bits, 1};
+
+            build_table(code, sub_offset, sub_bits, consumed + bits, i, k);
+
+            i = k;
+        }
+    }
+}
+
+template <typename KeyType>
+HuffmanDecoder<KeyType>::HuffmanDecoder(const CanonicalCode<KeyType> &code, uint64_t root_bits) :
+    root_bits(std::max<uint64_t>(1, std::min(root_bits, code.get_max_length()))),
+    stride(code.get_stride()) {
+    symbols.resize(code.size());
+
+    for (uint64_t i = 0; i < code.size(); i++) {
+        symbols[i] = code.get_symbol(i);
+    }
+
+    table.resize(uint64_t{1} << this->root_bits);
+
+    // a single symbol is coded with zero bits
+    if (code.get_max_length() == 0) {
+        std::fill(table.begin(), table.end(), Entry{0, 0, 0});
+        return;
+    }
+
+    build_table(code, 0, this->root_bits, 0, 0, code.size());
+}
+
+template <typename KeyType>
+inline uint64_t HuffmanDecoder<KeyType>::decode_index(BitReader &reader) const {
+    uint64_t bits = root_bits;
+
+    reader.refill();
+    Entry entry = table[reader.peek(bits)];
+
+    while (entry.link) [[unlikely]] {
+        reader.consume(bits);
+        reader.refill();
+
+        bits = entry.bits;
+        entry = table[entry.value + reader.peek(bits)];
+    }
+
+    reader.consume(entry.bits);
+
+    return entry.value;
+}
+
+template <typename KeyType>
+inline KeyType HuffmanDecoder<KeyType>::decode_symbol(BitReader &reader) const {
+    return symbols[decode_index(reader)];
+}
+
+template <typename KeyType>
+KeyType HuffmanDecoder<KeyType>::get_symbol(uint64_t idx) const {
+    return symbols[idx];
+}
+
+// rebuilds the original buffer of nbytes bytes from nsymbols codewords
+template <typename KeyType>
+std::vector<uint8_t> HuffmanDecoder<KeyType>::decode(const std::vector<uint8_t> &bits, uint64_t nsymbols, uint64_t nbytes) const {
+    BitReader reader{bits};
+    BitWriter writer{nbytes};
+
+    for (uint64_t i = 0; i < nsymbols; i++) {
+        write_symbol(writer, decode_symbol(reader), stride);
+    }
+
+    std::vector<uint8_t> buf = writer.flush();
+    buf.resize(nbytes);
+
+    return buf;
+}
+
+// A speculative path may hit a hole of a length-limited (incomplete) code,
+// which consumes nothing, so at least one bit is always skipped.
+template <typename KeyType>
+inline void HuffmanDecoder<KeyType>::skip_symbol(BitReader &reader) const {
+    uint64_t pos = reader.tell();
+
+    decode_index(reader);
+
+    if (reader.tell() == pos) [[unlikely]] {
+        reader.consume(1);
+    }
+}
+
+// Decodes a single stream on all threads, the stream format is unchanged.
+//   1. Every chunk of chunk_bits bits is decoded speculatively from its first
+//      bit, which may fall inside a codeword.
+//   2. A serial pass walks the true path from the previous chunk's exit until
+//      it meets a codeword boundary of the speculative path. Huffman codes
+//      resynchronize within a few codewords, and from that boundary on the
+//      speculative symbols, count and exit are right.
+//   3. The chunks are stitched in parallel. For byte-aligned strides the
+//      speculative output is kept and only the few symbols before the sync
+//      point are decoded again. Otherwise, or if a chunk never synchronized,
+//      the chunk is decoded again from its true start into a buffer aligned
+//      to its output bit offset.
+template <typename KeyType>
+std::vector<uint8_t> HuffmanDecoder<KeyType>::decode_parallel(const std::vector<uint8_t> &bits, uint64_t nsymbols, uint64_t nbytes, uint64_t chunk_bits) const {
+    const uint64_t total_bits = bits.size() * 8;
+    const bool aligned = stride % 8 == 0;
+    uint64_t nthreads = 1;
+
+    #ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+    #endif
+
+    if (chunk_bits == 0) {
+        chunk_bits = total_bits / (4 * nthreads) + 1;
+    }
+
+    // no codeword may span more than two chunks
+    chunk_bits = std::max<uint64_t>(chunk_bits, uint64_t{1} << 16);
+
+    const uint64_t nchunks = (total_bits + chunk_bits - 1) / chunk_bits;
+
+    // zero-length codes carry no boundaries to synchronize on
+    if (nchunks <= 1 || symbols.size() <= 1) {
+        return decode(bits, nsymbols, nbytes);
+    }
+
+    std::vector<uint64_t> start(nchunks + 1);
+    std::vector<uint64_t> exit(nchunks);
+    std::vector<uint64_t> count(nchunks);
+    std::vector<std::vector<uint8_t>> guess_out(aligned ? nchunks : 0);
+
+    for (uint64_t t = 0; t < nchunks; t++) {
+        start[t] = t * chunk_bits;
+    }
+
+    start[nchunks] = total_bits;
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (uint64_t t = 0; t < nchunks; t++) {
+        BitReader reader{bits.data(), bits.size(), start[t]};
+        uint64_t n = 0;
+
+        if (aligned) {
+            BitWriter writer{chunk_bits / 8};
+
+            while (reader.tell() < start[t + 1]) {
+                uint64_t pos = reader.tell();
+                uint64_t idx = decode_index(reader);
+
+                if (reader.tell() == pos) [[unlikely]] {
+                    reader.consume(1);
+                }
+
+                write_symbol(writer, symbols[idx], stride);
+                n++;
+            }
+
+            guess_out[t] = writer.flush();
+        }
+        else {
+            while (reader.tell() < start[t + 1]) {
+                skip_symbol(reader);
+                n++;
+            }
+        }
+
+        exit[t] = reader.tell();
+        count[t] = n;
+    }
+
+    // begin[t] is the true start of chunk t, the exit of chunk t - 1 once that one is right.
+    // The true path has prefix[t] symbols before it meets the speculative one, which
+    // drops its first skip[t] symbols.
+    std::vector<uint64_t> begin(nchunks, 0);
+    std::vector<uint64_t> prefix(nchunks, 0);
+    std::vector<uint64_t> skip(nchunks, 0);
+    std::vector<uint8_t> synced(nchunks, 1);
+
+    for (uint64_t t = 1; t < nchunks; t++) {
+        begin[t] = exit[t - 1];
+
+        if (begin[t] == start[t]) continue;
+
+        BitReader truth{bits.data(), bits.size(), begin[t]};
+        BitReader guess{bits.data(), bits.size(), start[t]};
+        uint64_t ntruth = 0;
+        uint64_t nguess = 0;
+
+        while (truth.tell() != guess.tell() && truth.tell() < start[t + 1]) {
+            if (truth.tell() < guess.tell() || guess.tell() >= start[t + 1]) {
+                skip_symbol(truth);
+                ntruth++;
+            }
+            else {
+                skip_symbol(guess);
+                nguess++;
+            }
+        }
+
+        if (truth.tell() == guess.tell()) {
+            count[t] = ntruth + count[t] - nguess;
+            prefix[t] = ntruth;
+            skip[t] = nguess;
+        }
+        else {
+            count[t] = ntruth;
+            exit[t] = truth.tell();
+            synced[t] = 0;
+        }
+    }
+
+    // the zero padding of the last byte may decode into extra symbols
+    std::vector<uint64_t> offset(nchunks + 1, 0);
+
+    for (uint64_t t = 0; t < nchunks; t++) {
+        count[t] = std::min(count[t], nsymbols - offset[t]);
+        offset[t + 1] = offset[t] + count[t];
+    }
+
+    std::vector<uint8_t> buf((nsymbols * stride + 7) / 8, 0);
+    std::vector<uint8_t> first(nchunks, 0);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (uint64_t t = 0; t < nchunks; t++) {
+        if (count[t] == 0) continue;
+
+        BitReader reader{bits.data(), bits.size(), begin[t]};
+        uint64_t pos = offset[t] * stride / 8;
+
+        if (aligned && synced[t]) {
+            uint64_t nprefix = std::min(prefix[t], count[t]);
+            BitWriter writer{nprefix * stride / 8};
+
+            for (uint64_t i = 0; i < nprefix; i++) {
+                write_symbol(writer, decode_symbol(reader), stride);
+            }
+
+            std::vector<uint8_t> local = writer.flush();
+
+            std::memcpy(buf.data() + pos, local.data(), local.size());
+            std::memcpy(buf.data() + pos + local.size(), guess_out[t].data() + skip[t] * stride / 8, (count[t] - nprefix) * stride / 8);
+            continue;
+        }
+
+        BitWriter writer{(count[t] * stride + 7) / 8 + 1};
+
+        writer.write(0, offset[t] * stride % 8);
+
+        for (uint64_t i = 0; i < count[t]; i++) {
+            write_symbol(writer, decode_symbol(reader), stride);
+        }
+
+        std::vector<uint8_t> local = writer.flush();
+
+        // the first byte may be shared with the previous chunk
+        first[t] = local[0];
+        std::memcpy(buf.data() + pos + 1, local.data() + 1, local.size() - 1);
+    }
+
+    for (uint64_t t = 0; t < nchunks; t++) {
+        if (count[t]) {
+            buf[offset[t] * stride / 8] |= first[t];
+        }
+    }
+
+    buf.resize(nbytes);
+
+    return buf;
+}
+
+// The nstreams readers have no data dependency on each other, so one round of
+// the loop keeps nstreams table lookups in flight instead of one.
+template <typename KeyType>
+template <uint64_t nstreams>
+std::vector<uint8_t> HuffmanDecoder<KeyType>::decode_interleaved(const std::vector<uint8_t> &bits, uint64_t nsymbols, uint64_t nbytes) const {
+    std::vector<BitReader> readers;
+    uint64_t pos = nstreams * sizeof (uint64_t);
+
+    readers.reserve(nstreams);
+
+    for (uint64_t s = 0; s < nstreams; s++) {
+        uint64_t size = load_stream_size(bits, s);
+
+        readers.emplace_back(bits.data() + pos, size);
+        pos += size;
+    }
+
+    BitWriter writer{nbytes};
+    uint64_t i = 0;
+
+    for (; i + nstreams <= nsymbols; i += nstreams) {
+        uint64_t idx[nstreams];
+
+        #pragma GCC unroll 8
+        for (uint64_t s = 0; s < nstreams; s++) {
+            idx[s] = decode_index(readers[s]);
+        }
+
+        #pragma GCC unroll 8
+        for (uint64_t s = 0; s < nstreams; s++) {
+            write_symbol(writer, symbols[idx[s]], stride);
+        }
+    }
+
+    for (uint64_t s = 0; i < nsymbols; i++, s++) {
+        write_symbol(writer, decode_symbol(readers[s]), stride);
+    }
+
+    std::vector<uint8_t> buf = writer.flush();
+    buf.resize(nbytes);
+
+    return buf;
+}
+
+template <typename KeyType>
+uint64_t HuffmanDecoder<KeyType>::get_root_bits() const {
+    return root_bits;
+}
+
+template <typename KeyType>
+uint64_t HuffmanDecoder<KeyType>::get_table_size() const {
+    return table.size();
+}
+
+#endif
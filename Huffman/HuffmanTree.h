@@ -0,0 +1,124 @@
+#ifndef __HUFFMAN_TREE_H__
+#define __HUFFMAN_TREE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Struct-of-arrays Huffman tree carved out of a single arena. Leaves take the
+// indices [0, nleaves) and internal nodes follow in creation order, so every
+// parent has a larger index than its children and the depths come out of one
+// reverse pass over the parent array, no recursion and no pointer chasing.
+template <typename KeyType, typename ValueType>
+class HuffmanTree {
+    std::unique_ptr<std::byte[]> arena;
+    ValueType *weight;
+    KeyType *tag;
+    uint64_t *parent;
+    uint64_t *left;
+    uint64_t *right;
+    uint64_t nleaves;
+    uint64_t nnodes;
+
+    static uint64_t align(uint64_t offset) {
+        return (offset + alignof (std::max_align_t) - 1) & ~(alignof (std::max_align_t) - 1);
+    }
+
+public:
+    HuffmanTree(uint64_t nleaves) : nleaves(nleaves), nnodes(nleaves) {
+        const uint64_t ntotal = nleaves ? 2*nleaves - 1 : 0;
+        const uint64_t ninternal = nleaves ? nleaves - 1 : 0;
+
+        const uint64_t tag_offset    = align(ntotal * sizeof (ValueType));
+        const uint64_t parent_offset = align(tag_offset + nleaves * sizeof (KeyType));
+        const uint64_t left_offset   = parent_offset + ntotal * sizeof (uint64_t);
+        const uint64_t right_offset  = left_offset + ninternal * sizeof (uint64_t);
+        const uint64_t nbytes        = right_offset + ninternal * sizeof (uint64_t);
+
+        arena.reset(new std::byte[nbytes]);
+
+        weight = reinterpret_cast<ValueType *>(arena.get());
+        tag    = reinterpret_cast<KeyType *>(arena.get() + tag_offset);
+        parent = reinterpret_cast<uint64_t *>(arena.get() + parent_offset);
+        left   = reinterpret_cast<uint64_t *>(arena.get() + left_offset) - nleaves;
+        right  = reinterpret_cast<uint64_t *>(arena.get() + right_offset) - nleaves;
+    }
+
+    // leaves may be set in any order and from several threads
+    void set_leaf(uint64_t idx, KeyType key, ValueType w) {
+        tag[idx] = key;
+        weight[idx] = w;
+    }
+
+    uint64_t add_internal(uint64_t lhs, uint64_t rhs) {
+        const uint64_t idx = nnodes++;
+
+        weight[idx] = weight[lhs] + weight[rhs];
+        left[idx] = lhs;
+        right[idx] = rhs;
+        parent[lhs] = idx;
+        parent[rhs] = idx;
+
+        return idx;
+    }
+
+    uint64_t size() const {
+        return nnodes;
+    }
+
+    uint64_t count_leaves() const {
+        return nleaves;
+    }
+
+    uint64_t get_root() const {
+        return nnodes - 1;
+    }
+
+    bool is_leaf(uint64_t idx) const {
+        return idx < nleaves;
+    }
+
+    ValueType get_weight(uint64_t idx) const {
+        return weight[idx];
+    }
+
+    // the weight array doubles as the heap payload of the naive build
+    ValueType * get_weight_ptr(uint64_t idx) {
+        return weight + idx;
+    }
+
+    uint64_t index_of(const ValueType *ptr) const {
+        return ptr - weight;
+    }
+
+    KeyType get_tag(uint64_t idx) const {
+        return tag[idx];
+    }
+
+    uint64_t get_left(uint64_t idx) const {
+        return left[idx];
+    }
+
+    uint64_t get_right(uint64_t idx) const {
+        return right[idx];
+    }
+
+    // Calls func(tag, weight, depth) for every leaf. The parent slots are
+    // overwritten by depths from the root down, so the tree is consumed.
+    template <typename Func>
+    void consume_leaf_depths(Func &&func) {
+        if (nnodes == 0) return;
+
+        parent[nnodes - 1] = 0;
+
+        for (uint64_t i = nnodes - 1; i-- > 0;) {
+            parent[i] = parent[parent[i]] + 1;
+        }
+
+        for (uint64_t i = 0; i < nleaves; i++) {
+            func(tag[i], weight[i], parent[i]);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory-mapped file, pages are faulted in by the kernel on first
+// touch instead of being copied through iostreams
+class MappedFile {
+    const uint8_t *addr;
+    uint64_t nbytes;
+    bool failed;
+
+public:
+    MappedFile(const std::string &);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+    ~MappedFile();
+    bool fail() const;
+    uint64_t size() const;
+    const uint8_t * data() const;
+    std::span<const uint8_t> span() const;
+};
+
+inline MappedFile::MappedFile(const std::string &path) : addr(nullptr), nbytes(0), failed(true) {
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) return;
+
+    struct stat st;
+
+    if (fstat(fd, &st) == 0) {
+        nbytes = st.st_size;
+        failed = false;
+
+        // mmap rejects empty mappings
+        if (nbytes) {
+            void *ptr = mmap(nullptr, nbytes, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (ptr == MAP_FAILED) {
+                nbytes = 0;
+                failed = true;
+            }
+            else {
+                addr = static_cast<const uint8_t *>(ptr);
+
+                madvise(ptr, nbytes, MADV_SEQUENTIAL);
+                #ifdef MADV_HUGEPAGE
+                madvise(ptr, nbytes, MADV_HUGEPAGE);
+                #endif
+            }
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+inline MappedFile::~MappedFile() {
+    if (addr) {
+        munmap(const_cast<uint8_t *>(addr), nbytes);
+    }
+}
+
+inline bool MappedFile::fail() const {
+    return failed;
+}
+
+inline uint64_t MappedFile::size() const {
+    return nbytes;
+}
+
+inline const uint8_t * MappedFile::data() const {
+    return addr;
+}
+
+inline std::span<const uint8_t> MappedFile::span() const {
+    return {addr, nbytes};
+}
+
+#endif
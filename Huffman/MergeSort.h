@@ -36,4 +36,33 @@ void mergesort(std::vector<ValType *> &arr) {
     mergesort(arr, 0, arr.size() - 1);
 }
 
+// sorts values in place, comp is a strict weak ordering
+template <typename ValType, typename Compare>
+void mergesort(std::vector<ValType> &arr, uint64_t left, uint64_t right, Compare comp) {
+    if (left >= right) return;
+
+    if (right - left >= 16) {
+        uint64_t mid = left + (right - left)/2;
+
+        #pragma omp task shared(arr) untied if (right - left >= 8192)
+        mergesort(arr, left, mid, comp);
+        #pragma omp task shared(arr) untied if (right - left >= 8192)
+        mergesort(arr, mid + 1, right, comp);
+        #pragma omp taskwait
+        std::inplace_merge(arr.begin() + left, arr.begin() + mid + 1, arr.begin() + right + 1, comp);
+    }
+    else {
+        std::sort(arr.begin() + left, arr.begin() + right + 1, comp);
+    }
+}
+
+template <typename ValType, typename Compare>
+void mergesort(std::vector<ValType> &arr, Compare comp) {
+    if (arr.empty()) return;
+
+    #pragma omp parallel
+    #pragma omp single
+    mergesort(arr, 0, arr.size() - 1, comp);
+}
+
 #endif
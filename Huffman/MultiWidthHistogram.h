@@ -0,0 +1,292 @@
+#ifndef __MULTI_WIDTH_HISTOGRAM_H__
+#define __MULTI_WIDTH_HISTOGRAM_H__
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "AlphabetStream.h"
+#include "Frequency.h"
+#include "Histogram.h"
+#include "RadixSort.h"
+
+// Statistics of one buffer at many symbol widths. The counters of a pass all
+// walk the same cache-sized chunk before moving on, so the input is streamed
+// once per pass instead of once per width. A width that divides a wider one in
+// the set is not counted at all: every w-bit field of a W-bit key occurs as
+// often as the key, so its table is split out of the W-bit table. Narrow widths
+// (dense tables) are only split out of dense tables, otherwise a pass over a
+// dense counter is cheaper than walking a sparse table. Sparse counters keep
+// every key until the end of their pass, at most max_sparse of them share one.
+template <typename KeyType, typename ValueType=uint64_t, typename FreqType=Frequency<KeyType, ValueType>>
+class MultiWidthHistogram {
+    static constexpr uint64_t dense_bits = 16;
+
+    // sorted (key, count) runs, split and handed out without any lookups
+    struct Runs {
+        std::vector<KeyType> keys;
+        std::vector<ValueType> counts;
+    };
+
+    struct Counter {
+        uint64_t stride;
+        uint64_t ncounted;
+        AlphabetStream<KeyType> data;
+        std::vector<uint64_t> dense;
+        std::vector<KeyType> keys;
+
+        Counter(std::span<const uint8_t> buf, uint64_t stride) :
+        stride(stride), ncounted(0), data(buf, stride), dense(stride <= dense_bits ? uint64_t{1} << stride : 0) {}
+    };
+
+    std::span<const uint8_t> buf;
+    std::vector<uint64_t> widths;
+    std::vector<uint64_t> source;
+    std::vector<std::vector<uint64_t>> children;
+    uint64_t max_sparse;
+    uint64_t chunk_size;
+    uint64_t npasses;
+    std::chrono::duration<double> elapsed_time;
+
+    uint64_t count_symbols(uint64_t stride) const {
+        return (buf.size() * 8 + stride - 1) / stride;
+    }
+
+    // counts the symbols of c that start before byte end
+    void feed(Counter &c, uint64_t begin, uint64_t end) const {
+        if (sizeof (KeyType) * 8 >= c.stride && (c.stride == 8 || c.stride == 16)) {
+            (c.stride == 8 ? histogram_8 : histogram_16)(buf.data() + begin, end - begin, c.dense.data());
+            return;
+        }
+
+        const uint64_t last = std::min(count_symbols(c.stride), (end * 8 + c.stride - 1) / c.stride);
+
+        if (!c.dense.empty()) {
+            for (; c.ncounted < last; c.ncounted++) {
+                c.dense[(uint64_t)c.data.next()]++;
+            }
+        }
+        else {
+            for (; c.ncounted < last; c.ncounted++) {
+                c.keys.push_back(c.data.next());
+            }
+        }
+    }
+
+    static Runs dense_runs(const std::vector<uint64_t> &counts) {
+        Runs runs;
+
+        for (uint64_t k = 0; k < counts.size(); k++) {
+            if (counts[k]) {
+                runs.keys.push_back(k);
+                runs.counts.push_back(counts[k]);
+            }
+        }
+
+        return runs;
+    }
+
+    static Runs sorted_runs(std::vector<KeyType> &keys, uint64_t stride) {
+        Runs runs;
+
+        radix_sort(keys, stride);
+
+        for (uint64_t i = 0; i < keys.size(); i++) {
+            if (runs.keys.empty() || runs.keys.back() != keys[i]) {
+                runs.keys.push_back(keys[i]);
+                runs.counts.push_back(1);
+            }
+            else {
+                runs.counts.back()++;
+            }
+        }
+
+        return runs;
+    }
+
+    // the W-bit table yields W/w fields per key. Its zero-padded last symbol also
+    // yields fields past the end of the buffer, those are zero and get dropped.
+    Runs derive(const Runs &src, uint64_t src_stride, uint64_t stride) const {
+        const uint64_t nfields = src_stride / stride;
+        const KeyType mask = (KeyType{1} << stride) - 1;
+        const uint64_t extra = count_symbols(src_stride) * nfields - count_symbols(stride);
+
+        std::vector<uint64_t> dense(stride <= dense_bits ? uint64_t{1} << stride : 0, 0);
+        std::vector<std::pair<KeyType, ValueType>> fields;
+        uint64_t zeros = 0;
+
+        for (uint64_t i = 0; i < src.keys.size(); i++) {
+            for (uint64_t f = 0; f < nfields; f++) {
+                KeyType field = (src.keys[i] >> (f * stride)) & mask;
+
+                if (field == 0) {
+                    zeros += src.counts[i];
+                }
+                else if (!dense.empty()) {
+                    dense[(uint64_t)field] += src.counts[i];
+                }
+                else {
+                    fields.emplace_back(field, src.counts[i]);
+                }
+            }
+        }
+
+        if (!dense.empty()) {
+            dense[0] = zeros - extra;
+            return dense_runs(dense);
+        }
+
+        radix_sort(fields, stride, [](const std::pair<KeyType, ValueType> &p) { return p.first; });
+
+        Runs runs;
+
+        if (zeros > extra) {
+            runs.keys.push_back(0);
+            runs.counts.push_back(zeros - extra);
+        }
+
+        for (auto &[key, count] : fields) {
+            if (runs.keys.empty() || runs.keys.back() != key) {
+                runs.keys.push_back(key);
+                runs.counts.push_back(count);
+            }
+            else {
+                runs.counts.back() += count;
+            }
+        }
+
+        return runs;
+    }
+
+    // children first, so a table is released as soon as the last one is split out
+    template <typename Func>
+    void emit(uint64_t idx, Runs &&runs, Func &func) const {
+        for (uint64_t child : children[idx]) {
+            emit(child, derive(runs, widths[idx], widths[child]), func);
+        }
+
+        // a FreqType that keeps sorted runs itself (SortFrequency) adopts them as they are
+        if constexpr (std::is_constructible_v<FreqType, KeyType, std::vector<KeyType> &&, std::vector<ValueType> &&>) {
+            func(widths[idx], FreqType{KeyType{1} << widths[idx], std::move(runs.keys), std::move(runs.counts)});
+        }
+        else {
+            FreqType freq{KeyType{1} << widths[idx]};
+
+            for (uint64_t i = 0; i < runs.keys.size(); i++) {
+                freq.count(runs.keys[i], runs.counts[i]);
+            }
+
+            runs = Runs{};
+
+            func(widths[idx], std::move(freq));
+        }
+    }
+
+public:
+    MultiWidthHistogram(std::span<const uint8_t> buf, std::vector<uint64_t> widths, uint64_t max_sparse=8, uint64_t chunk_size=1 * 1024 * 1024) :
+    buf(buf), widths(std::move(widths)), max_sparse(std::max<uint64_t>(max_sparse, 1)), chunk_size(std::max<uint64_t>(2, chunk_size & ~uint64_t{1})), npasses(0), elapsed_time(0) {
+        std::sort(this->widths.begin(), this->widths.end());
+        this->widths.erase(std::unique(this->widths.begin(), this->widths.end()), this->widths.end());
+
+        const uint64_t n = this->widths.size();
+
+        source.assign(n, n);
+        children.resize(n);
+
+        for (uint64_t i = 0; i < n; i++) {
+            const uint64_t w = this->widths[i];
+
+            assert(w > 0 && w < sizeof (KeyType) * 8);
+
+            for (uint64_t j = i + 1; j < n; j++) {
+                const uint64_t W = this->widths[j];
+
+                if (W % w == 0 && (w > dense_bits || W <= dense_bits)) {
+                    source[i] = j;
+                    children[j].push_back(i);
+                    break;
+                }
+            }
+        }
+    }
+
+    // calls func(width, FreqType &&) once per width, from several threads at once
+    template <typename Func>
+    void for_each(Func &&func) {
+        std::vector<uint64_t> dense;
+        std::vector<uint64_t> sparse;
+
+        for (uint64_t i = widths.size(); i-- > 0;) {
+            if (source[i] == widths.size()) {
+                (widths[i] <= dense_bits ? dense : sparse).push_back(i);
+            }
+        }
+
+        elapsed_time = std::chrono::duration<double>(0);
+        npasses = 0;
+
+        for (uint64_t first = 0; first < sparse.size() || (first == 0 && !dense.empty()); first += max_sparse) {
+            std::vector<uint64_t> pass(sparse.begin() + std::min(first, sparse.size()), sparse.begin() + std::min(first + max_sparse, sparse.size()));
+
+            if (first == 0) {
+                pass.insert(pass.end(), dense.begin(), dense.end());
+            }
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+
+            std::vector<Counter> counters;
+            counters.reserve(pass.size());
+
+            for (uint64_t idx : pass) {
+                counters.emplace_back(buf, widths[idx]);
+            }
+
+            for (uint64_t begin = 0; begin < buf.size(); begin += chunk_size) {
+                const uint64_t end = std::min(buf.size(), begin + chunk_size);
+
+                #pragma omp parallel for schedule(dynamic, 1)
+                for (uint64_t c = 0; c < counters.size(); c++) {
+                    feed(counters[c], begin, end);
+                }
+            }
+
+            std::vector<Runs> runs(counters.size());
+
+            // one at a time, radix_sort already runs on all threads
+            for (uint64_t c = 0; c < counters.size(); c++) {
+                runs[c] = counters[c].dense.empty() ? sorted_runs(counters[c].keys, counters[c].stride) : dense_runs(counters[c].dense);
+                std::vector<uint64_t>().swap(counters[c].dense);
+                std::vector<KeyType>().swap(counters[c].keys);
+            }
+
+            elapsed_time += std::chrono::high_resolution_clock::now() - start_time;
+            npasses++;
+
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (uint64_t c = 0; c < counters.size(); c++) {
+                emit(pass[c], std::move(runs[c]), func);
+            }
+        }
+    }
+
+    // widths whose table is split out of a wider one instead of counted
+    uint64_t count_derived() const {
+        return std::count_if(source.begin(), source.end(), [&](uint64_t s) { return s != widths.size(); });
+    }
+
+    uint64_t count_passes() const {
+        return npasses;
+    }
+
+    // time spent streaming and sorting the input, splitting and func are not included
+    double get_execution_time() const {
+        return elapsed_time.count();
+    }
+};
+
+#endif
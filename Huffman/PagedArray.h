@@ -0,0 +1,195 @@
+#ifndef __PAGED_ARRAY_H__
+#define __PAGED_ARRAY_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+// Two-level dense counter array, a page of 4096 counters is allocated and zeroed
+// on first write, so memory follows the touched part of the alphabet. Reads of
+// untouched pages return 0 without allocating. With noreserve the whole range is
+// one MAP_NORESERVE anonymous mapping and the kernel supplies zero pages lazily,
+// the directory then only records which pages were touched.
+template <typename ValueType, bool noreserve=false>
+class PagedArray {
+    static constexpr uint64_t page_bits = 12;
+    static constexpr uint64_t page_size = uint64_t{1} << page_bits;
+
+    std::vector<ValueType *> pages;
+    ValueType *base;
+    uint64_t nelem;
+    uint64_t npages;
+
+    ValueType * alloc_page(uint64_t);
+    void release();
+
+public:
+    PagedArray(uint64_t=0);
+    PagedArray(const PagedArray &);
+    PagedArray(PagedArray &&);
+    PagedArray & operator=(const PagedArray &);
+    PagedArray & operator=(PagedArray &&);
+    ~PagedArray();
+    ValueType & operator[](uint64_t);
+    ValueType get(uint64_t) const;
+    uint64_t size() const;
+    uint64_t count_pages() const;
+    uint64_t memory_usage() const;
+    template <typename Func> void for_each(Func &&) const;
+    void clear();
+};
+
+template <typename ValueType, bool noreserve>
+ValueType * PagedArray<ValueType, noreserve>::alloc_page(uint64_t p) {
+    npages++;
+
+    if constexpr (noreserve) {
+        if (base) {
+            return base + p*page_size;
+        }
+    }
+
+    return new ValueType[page_size]();
+}
+
+template <typename ValueType, bool noreserve>
+void PagedArray<ValueType, noreserve>::release() {
+    if (base) {
+        munmap(base, pages.size() * page_size * sizeof (ValueType));
+    }
+    else {
+        for (auto page : pages) {
+            delete[] page;
+        }
+    }
+
+    pages.clear();
+    base = nullptr;
+    npages = 0;
+}
+
+template <typename ValueType, bool noreserve>
+PagedArray<ValueType, noreserve>::PagedArray(uint64_t nelem) :
+    pages((nelem + page_size - 1) / page_size, nullptr), base(nullptr), nelem(nelem), npages(0) {
+    if constexpr (noreserve) {
+        if (!pages.empty()) {
+            void *ptr = mmap(nullptr, pages.size() * page_size * sizeof (ValueType), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+
+            // falls back to heap pages
+            if (ptr != MAP_FAILED) {
+                base = static_cast<ValueType *>(ptr);
+            }
+        }
+    }
+}
+
+template <typename ValueType, bool noreserve>
+PagedArray<ValueType, noreserve>::PagedArray(const PagedArray &other) : PagedArray(0) {
+    *this = other;
+}
+
+template <typename ValueType, bool noreserve>
+PagedArray<ValueType, noreserve>::PagedArray(PagedArray &&other) : base(nullptr), nelem(0), npages(0) {
+    *this = std::move(other);
+}
+
+// the copy always uses heap pages
+template <typename ValueType, bool noreserve>
+PagedArray<ValueType, noreserve> & PagedArray<ValueType, noreserve>::operator=(const PagedArray &other) {
+    if (this == &other) return *this;
+
+    release();
+
+    pages.assign(other.pages.size(), nullptr);
+    nelem = other.nelem;
+    npages = other.npages;
+
+    for (uint64_t p = 0; p < pages.size(); p++) {
+        if (other.pages[p]) {
+            pages[p] = new ValueType[page_size];
+            std::memcpy(pages[p], other.pages[p], page_size * sizeof (ValueType));
+        }
+    }
+
+    return *this;
+}
+
+template <typename ValueType, bool noreserve>
+PagedArray<ValueType, noreserve> & PagedArray<ValueType, noreserve>::operator=(PagedArray &&other) {
+    if (this == &other) return *this;
+
+    release();
+
+    pages = std::move(other.pages);
+    base = std::exchange(other.base, nullptr);
+    nelem = std::exchange(other.nelem, 0);
+    npages = std::exchange(other.npages, 0);
+    other.pages.clear();
+
+    return *this;
+}
+
+template <typename ValueType, bool noreserve>
+PagedArray<ValueType, noreserve>::~PagedArray() {
+    release();
+}
+
+template <typename ValueType, bool noreserve>
+inline ValueType & PagedArray<ValueType, noreserve>::operator[](uint64_t idx) {
+    ValueType *&page = pages[idx >> page_bits];
+
+    if (page == nullptr) [[unlikely]] {
+        page = alloc_page(idx >> page_bits);
+    }
+
+    return page[idx & (page_size - 1)];
+}
+
+template <typename ValueType, bool noreserve>
+inline ValueType PagedArray<ValueType, noreserve>::get(uint64_t idx) const {
+    const ValueType *page = pages[idx >> page_bits];
+    return page ? page[idx & (page_size - 1)] : 0;
+}
+
+template <typename ValueType, bool noreserve>
+uint64_t PagedArray<ValueType, noreserve>::size() const {
+    return nelem;
+}
+
+template <typename ValueType, bool noreserve>
+uint64_t PagedArray<ValueType, noreserve>::count_pages() const {
+    return npages;
+}
+
+// bytes of touched pages plus the directory
+template <typename ValueType, bool noreserve>
+uint64_t PagedArray<ValueType, noreserve>::memory_usage() const {
+    return npages * page_size * sizeof (ValueType) + pages.size() * sizeof (ValueType *);
+}
+
+// calls func(idx, val) on the nonzero counters of the touched pages
+template <typename ValueType, bool noreserve>
+template <typename Func>
+void PagedArray<ValueType, noreserve>::for_each(Func &&func) const {
+    for (uint64_t p = 0; p < pages.size(); p++) {
+        if (pages[p] == nullptr) continue;
+
+        for (uint64_t i = 0; i < page_size; i++) {
+            if (pages[p][i]) {
+                func(p*page_size + i, pages[p][i]);
+            }
+        }
+    }
+}
+
+template <typename ValueType, bool noreserve>
+void PagedArray<ValueType, noreserve>::clear() {
+    release();
+    nelem = 0;
+}
+
+#endif
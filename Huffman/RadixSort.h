@@ -0,0 +1,97 @@
+#ifndef __RADIX_SORT_H__
+#define __RADIX_SORT_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Parallel LSD radix sort on the low key_bits bits of key(elem), one byte per pass.
+// Each thread counts and scatters its own contiguous block, so the sort is stable.
+// Passes where every key has the same digit are skipped.
+template <typename ElemType, typename KeyFunc>
+void radix_sort(std::vector<ElemType> &keys, uint64_t key_bits, KeyFunc key) {
+    constexpr uint64_t digit_bits = 8;
+    constexpr uint64_t radix = uint64_t{1} << digit_bits;
+
+    const uint64_t n = keys.size();
+    uint64_t max_threads = 1;
+
+    #ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+    #endif
+
+    std::vector<ElemType> tmp(n);
+    std::vector<uint64_t> offset(max_threads * radix);
+
+    for (uint64_t shift = 0; shift < key_bits; shift += digit_bits) {
+        bool skip = false;
+
+        #pragma omp parallel num_threads(max_threads)
+        {
+            uint64_t tid = 0;
+            uint64_t nthreads = 1;
+
+            #ifdef _OPENMP
+            tid = omp_get_thread_num();
+            nthreads = omp_get_num_threads();
+            #endif
+
+            const uint64_t begin = n * tid / nthreads;
+            const uint64_t end = n * (tid + 1) / nthreads;
+            uint64_t *count = offset.data() + tid*radix;
+
+            std::fill(count, count + radix, 0);
+
+            for (uint64_t i = begin; i < end; i++) {
+                count[(uint64_t)(key(keys[i]) >> shift) & (radix - 1)]++;
+            }
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                uint64_t sum = 0;
+
+                for (uint64_t d = 0; d < radix; d++) {
+                    uint64_t total = 0;
+
+                    for (uint64_t t = 0; t < nthreads; t++) {
+                        uint64_t c = offset[t*radix + d];
+                        offset[t*radix + d] = sum;
+                        sum += c;
+                        total += c;
+                    }
+
+                    skip |= total == n;
+                }
+            }
+
+            if (!skip) {
+                for (uint64_t i = begin; i < end; i++) {
+                    tmp[count[(uint64_t)(key(keys[i]) >> shift) & (radix - 1)]++] = keys[i];
+                }
+            }
+        }
+
+        if (!skip) {
+            std::swap(keys, tmp);
+        }
+    }
+}
+
+template <typename KeyType>
+void radix_sort(std::vector<KeyType> &keys, uint64_t key_bits) {
+    radix_sort(keys, key_bits, [](const KeyType &k) { return k; });
+}
+
+// (weight, index) pairs by weight, ties keep their index order
+template <typename ValueType>
+void radix_sort(std::vector<std::pair<ValueType, uint64_t>> &pairs, uint64_t key_bits) {
+    radix_sort(pairs, key_bits, [](const std::pair<ValueType, uint64_t> &p) { return p.first; });
+}
+
+#endif
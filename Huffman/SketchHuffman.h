@@ -0,0 +1,180 @@
+#ifndef __SKETCH_HUFFMAN_H__
+#define __SKETCH_HUFFMAN_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "AlphabetStream.h"
+#include "CodeLength.h"
+#include "SpaceSaving.h"
+
+// Approximate Huffman statistics in fixed memory for exploratory sweeps. The
+// symbols go through a Space-Saving sketch of `capacity` counters, the estimate
+// is the expected codeword length of a Huffman code over the guaranteed counts
+// plus an escape symbol for the unmonitored tail. The optimal length L
+// is bracketed by entropy bounds from the sketch guarantees:
+//   H_min <= H <= L < H_max + 1, and L <= stride
+// The estimate is not clamped into the bounds, both are reported as they are.
+// When nothing is evicted the counts are exact and so is the estimate.
+template <typename KeyType, typename ValueType=uint64_t>
+class SketchHuffman {
+    SpaceSaving<KeyType> sketch;
+    uint64_t stride;
+    std::chrono::duration<double> elapsed_time;
+    double expected_length;
+    double lower_bound;
+    double upper_bound;
+
+    void build_estimate() {
+        auto &counters = sketch.get_counters();
+        const double N = sketch.count_occurrence();
+
+        // (weight, is escape)
+        std::vector<std::pair<ValueType, bool>> leaves;
+        ValueType escape = 0;
+
+        for (auto &c : counters) {
+            if (c.count > c.error) {
+                leaves.push_back({c.count - c.error, false});
+            }
+
+            escape += c.error;
+        }
+
+        if (escape) {
+            leaves.push_back({escape, true});
+        }
+
+        std::sort(leaves.begin(), leaves.end());
+
+        std::vector<ValueType> lengths(leaves.size());
+
+        for (uint64_t i = 0; i < leaves.size(); i++) {
+            lengths[i] = leaves[i].first;
+        }
+
+        in_place_code_lengths(lengths);
+
+        // the escape codeword is followed by an index into the at most
+        // min(2^stride - capacity, escape) symbols outside the sketch
+        double others = std::ldexp(1.0, stride) - counters.size();
+        double payload = escape ? std::min<double>(stride, std::log2(std::max(1.0, std::min(others, 1.0 * escape)))) : 0;
+        double cost = 0;
+
+        for (uint64_t i = 0; i < leaves.size(); i++) {
+            cost += 1.0 * leaves[i].first * (lengths[i] + (leaves[i].second ? payload : 0));
+        }
+
+        expected_length = N ? cost / N : 0;
+
+        if (sketch.exact()) {
+            lower_bound = upper_bound = expected_length;
+            return;
+        }
+
+        // f(n) = contribution of a symbol occurring n times to the entropy
+        auto f = [&](double n) {
+            return n > 0 ? n / N * std::log2(N / n) : 0;
+        };
+
+        double h_low = 0;
+        double h_high = 0;
+        double tail = 0;
+        double top = 0;
+
+        for (auto &c : counters) {
+            double lo = c.count - c.error;
+            double hi = c.count;
+            double peak = std::clamp(N / std::exp(1.0), lo, hi);
+
+            h_high += std::max({f(lo), f(hi), f(peak)});
+            tail += c.error;
+            top = std::max(top, lo);
+        }
+
+        // Every monitored symbol occurs at least count - error times, the other
+        // `tail` occurrences may belong to any symbols. Piling all of them onto
+        // the largest guaranteed count gives a distribution that majorizes every
+        // one consistent with the sketch, and the entropy (a sum of the concave
+        // f) is Schur-concave, so it is the least entropy the data can have.
+        for (auto &c : counters) {
+            h_low += f(c.count - c.error);
+        }
+
+        h_low += f(top + tail) - f(top);
+
+        // at most `tail` occurrences are left for the symbols outside the sketch,
+        // spread over at most min(2^stride - capacity, tail) distinct symbols
+        auto g = [&](double t) {
+            return t >= 1 ? t / N * (std::log2(N / t) + std::log2(std::min(others, t))) : 0;
+        };
+
+        h_high += std::max({g(tail), g(std::min(tail, others)), g(std::clamp(N * others / std::exp(1.0), std::min(tail, others), tail))});
+
+        // monitored symbols all occurred, with two of them no codeword is shorter than a bit
+        lower_bound = counters.size() > 1 ? std::max(h_low, 1.0) : h_low;
+        upper_bound = std::min<double>(h_high + 1, stride);
+    }
+
+public:
+    SketchHuffman(std::span<const uint8_t> buf, uint64_t stride, uint64_t capacity=1 << 16) : sketch(capacity), stride(stride) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        for_each_alphabet<KeyType>(buf, stride, [&](KeyType alphabet) {
+            sketch.count(alphabet);
+        });
+
+        build_estimate();
+
+        elapsed_time = std::chrono::high_resolution_clock::now() - start_time;
+    }
+
+    // monitored symbols, a lower bound on the nonzero symbols
+    uint64_t get_nonzeros() const {
+        return sketch.size();
+    }
+
+    uint64_t get_occurrence() const {
+        return sketch.count_occurrence();
+    }
+
+    double get_expected_codeword_length() const {
+        return expected_length;
+    }
+
+    std::pair<double, double> get_expected_codeword_length_bounds() const {
+        return {lower_bound, upper_bound};
+    }
+
+    double get_compression_ratio() const {
+        return stride / expected_length;
+    }
+
+    double get_execution_time() const {
+        return elapsed_time.count();
+    }
+
+    void dump() const {
+        auto n  = get_nonzeros();
+        auto o  = get_occurrence();
+        auto cl = get_expected_codeword_length();
+        auto cr = get_compression_ratio();
+        auto t  = get_execution_time();
+
+        std::cout << "Symbol Length:            " << stride << " (bit)"      << std::endl;
+        std::cout << "Monitored Symbols:        " << n      << " / " << sketch.get_capacity() << std::endl;
+        std::cout << "Data Size:                " << o      << " (# symbol)" << std::endl;
+        std::cout << "Expected Codeword Length: " << cl     << " (bit, estimated)" << std::endl;
+        std::cout << "Codeword Length Bounds:   [" << lower_bound << ", " << upper_bound << "] (bit)" << std::endl;
+        std::cout << "Compression Ratio:        " << cr                      << std::endl;
+        std::cout << "Execution Time:           " << t      << " (second)"   << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef __SORT_FREQUENCY_H__
+#define __SORT_FREQUENCY_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "RadixSort.h"
+
+// Sort-based counting for wide strides, where almost every symbol is unique and
+// hashing buys nothing. count appends the key to a flat array, the first query
+// radix sorts the array and collapses it into sorted (key, count) runs in one
+// linear pass. Memory is one key per symbol plus the sort buffer. Drop-in
+// replacement for Frequency as the FreqType of Huffman.
+template <typename KeyType, typename ValueType>
+class SortFrequency {
+    mutable std::vector<KeyType> keys;
+    mutable std::vector<std::pair<KeyType, ValueType>> weighted;
+    mutable std::vector<KeyType> nonzero_elems;
+    mutable std::vector<ValueType> values;
+
+    KeyType nelem;
+    __uint128_t occurrence;
+
+    void collapse() const;
+
+public:
+    SortFrequency(KeyType);
+    SortFrequency(KeyType, std::vector<KeyType> &&, std::vector<ValueType> &&);
+    ValueType operator[](KeyType);
+    ValueType get(KeyType);
+    double get_freq(KeyType);
+    void count(KeyType);
+    void count(KeyType, __uint128_t);
+    void merge(SortFrequency &);
+    KeyType size() const;
+    __uint128_t count_occurrence() const;
+    KeyType count_nonzeros() const;
+    std::vector<KeyType> & get_nonzero_elems();
+    void clear();
+};
+
+template <typename KeyType, typename ValueType>
+void SortFrequency<KeyType, ValueType>::collapse() const {
+    if (keys.empty() && weighted.empty()) return;
+
+    uint64_t key_bits = 0;
+
+    while (key_bits < sizeof (KeyType) * 8 && (KeyType{1} << key_bits) < nelem) {
+        key_bits++;
+    }
+
+    radix_sort(keys, key_bits);
+
+    std::vector<std::pair<KeyType, ValueType>> runs;
+
+    for (uint64_t i = 0; i < keys.size(); i++) {
+        if (runs.empty() || runs.back().first != keys[i]) {
+            runs.push_back({keys[i], 1});
+        }
+        else {
+            runs.back().second++;
+        }
+    }
+
+    keys = std::vector<KeyType>{};
+
+    // weighted counts and earlier runs are rare, fold them in with a comparison sort
+    if (!weighted.empty() || !nonzero_elems.empty()) {
+        runs.insert(runs.end(), weighted.begin(), weighted.end());
+
+        for (uint64_t i = 0; i < nonzero_elems.size(); i++) {
+            runs.push_back({nonzero_elems[i], values[i]});
+        }
+
+        std::sort(runs.begin(), runs.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.first < rhs.first;
+        });
+
+        uint64_t last = 0;
+
+        for (uint64_t i = 1; i < runs.size(); i++) {
+            if (runs[i].first == runs[last].first) {
+                runs[last].second += runs[i].second;
+            }
+            else {
+                runs[++last] = runs[i];
+            }
+        }
+
+        runs.resize(last + 1);
+        weighted = std::vector<std::pair<KeyType, ValueType>>{};
+    }
+
+    nonzero_elems.resize(runs.size());
+    values.resize(runs.size());
+
+    for (uint64_t i = 0; i < runs.size(); i++) {
+        nonzero_elems[i] = runs[i].first;
+        values[i] = runs[i].second;
+    }
+}
+
+template <typename KeyType, typename ValueType>
+SortFrequency<KeyType, ValueType>::SortFrequency(KeyType nelem) : nelem(nelem), occurrence(0) {}
+
+// adopts runs that are already sorted by key and collapsed
+template <typename KeyType, typename ValueType>
+SortFrequency<KeyType, ValueType>::SortFrequency(KeyType nelem, std::vector<KeyType> &&keys, std::vector<ValueType> &&counts) :
+    nonzero_elems(std::move(keys)), values(std::move(counts)), nelem(nelem), occurrence(0) {
+    for (ValueType count : values) {
+        occurrence += count;
+    }
+}
+
+template <typename KeyType, typename ValueType>
+ValueType SortFrequency<KeyType, ValueType>::operator[](KeyType idx) {
+    return get(idx);
+}
+
+template <typename KeyType, typename ValueType>
+ValueType SortFrequency<KeyType, ValueType>::get(KeyType idx) {
+    collapse();
+
+    auto it = std::lower_bound(nonzero_elems.begin(), nonzero_elems.end(), idx);
+
+    if (it == nonzero_elems.end() || *it != idx) {
+        return 0;
+    }
+
+    return values[it - nonzero_elems.begin()];
+}
+
+template <typename KeyType, typename ValueType>
+double SortFrequency<KeyType, ValueType>::get_freq(KeyType idx) {
+    return 1.0 * get(idx) / occurrence;
+}
+
+template <typename KeyType, typename ValueType>
+inline void SortFrequency<KeyType, ValueType>::count(KeyType idx) {
+    keys.push_back(idx);
+    occurrence++;
+}
+
+template <typename KeyType, typename ValueType>
+void SortFrequency<KeyType, ValueType>::count(KeyType idx, __uint128_t amount) {
+    weighted.push_back({idx, (ValueType)amount});
+    occurrence += amount;
+}
+
+// appends other without sorting, so a tree of merges costs one sort at the end
+template <typename KeyType, typename ValueType>
+void SortFrequency<KeyType, ValueType>::merge(SortFrequency &other) {
+    if (other.keys.size() > keys.size()) {
+        std::swap(keys, other.keys);
+    }
+
+    keys.insert(keys.end(), other.keys.begin(), other.keys.end());
+    weighted.insert(weighted.end(), other.weighted.begin(), other.weighted.end());
+
+    for (uint64_t i = 0; i < other.nonzero_elems.size(); i++) {
+        weighted.push_back({other.nonzero_elems[i], other.values[i]});
+    }
+
+    occurrence += other.occurrence;
+    other.clear();
+}
+
+template <typename KeyType, typename ValueType>
+KeyType SortFrequency<KeyType, ValueType>::size() const {
+    return nelem;
+}
+
+template <typename KeyType, typename ValueType>
+__uint128_t SortFrequency<KeyType, ValueType>::count_occurrence() const {
+    return occurrence;
+}
+
+template <typename KeyType, typename ValueType>
+KeyType SortFrequency<KeyType, ValueType>::count_nonzeros() const {
+    collapse();
+    return nonzero_elems.size();
+}
+
+template <typename KeyType, typename ValueType>
+std::vector<KeyType> & SortFrequency<KeyType, ValueType>::get_nonzero_elems() {
+    collapse();
+    return nonzero_elems;
+}
+
+template <typename KeyType, typename ValueType>
+void SortFrequency<KeyType, ValueType>::clear() {
+    keys = std::vector<KeyType>{};
+    weighted = std::vector<std::pair<KeyType, ValueType>>{};
+    nonzero_elems = std::vector<KeyType>{};
+    values = std::vector<ValueType>{};
+    occurrence = 0;
+}
+
+#endif
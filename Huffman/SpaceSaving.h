@@ -0,0 +1,137 @@
+#ifndef __SPACE_SAVING_H__
+#define __SPACE_SAVING_H__
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "FlatMap.h"
+
+// Space-Saving heavy hitter sketch (Metwally et al.) with a fixed number of
+// counters. A monitored symbol's true count lies in [count - error, count], an
+// unmonitored symbol occurs at most get_min_count() times. The counters sit in
+// a min-heap on count, so evicting the smallest one is O(log capacity).
+template <typename KeyType>
+class SpaceSaving {
+public:
+    struct Counter {
+        KeyType key;
+        uint64_t count;
+        uint64_t error;
+    };
+
+private:
+    std::vector<Counter> heap;
+    FlatMap<KeyType, uint64_t> index;
+    uint64_t capacity;
+    uint64_t occurrence;
+    uint64_t evictions;
+
+    void sift_up(uint64_t);
+    void sift_down(uint64_t);
+
+public:
+    SpaceSaving(uint64_t);
+    void count(KeyType);
+    uint64_t size() const;
+    uint64_t get_capacity() const;
+    uint64_t get_min_count() const;
+    uint64_t count_occurrence() const;
+    bool exact() const;
+    const std::vector<Counter> & get_counters() const;
+};
+
+template <typename KeyType>
+SpaceSaving<KeyType>::SpaceSaving(uint64_t capacity) : capacity(capacity), occurrence(0), evictions(0) {
+    heap.reserve(capacity);
+    index.reserve(capacity);
+}
+
+template <typename KeyType>
+void SpaceSaving<KeyType>::sift_up(uint64_t idx) {
+    while (idx > 0 && heap[idx].count < heap[(idx - 1) / 2].count) {
+        std::swap(heap[idx], heap[(idx - 1) / 2]);
+        index[heap[idx].key] = idx;
+        idx = (idx - 1) / 2;
+    }
+
+    index[heap[idx].key] = idx;
+}
+
+template <typename KeyType>
+void SpaceSaving<KeyType>::sift_down(uint64_t idx) {
+    while (true) {
+        uint64_t smallest = idx;
+        uint64_t l = 2*idx + 1;
+        uint64_t r = 2*idx + 2;
+
+        if (l < heap.size() && heap[l].count < heap[smallest].count) smallest = l;
+        if (r < heap.size() && heap[r].count < heap[smallest].count) smallest = r;
+
+        if (smallest == idx) break;
+
+        std::swap(heap[idx], heap[smallest]);
+        index[heap[idx].key] = idx;
+        idx = smallest;
+    }
+
+    index[heap[idx].key] = idx;
+}
+
+template <typename KeyType>
+inline void SpaceSaving<KeyType>::count(KeyType key) {
+    occurrence++;
+
+    auto it = index.find(key);
+
+    if (it != index.end()) [[likely]] {
+        uint64_t idx = it->second;
+        heap[idx].count++;
+        sift_down(idx);
+    }
+    else if (heap.size() < capacity) {
+        heap.push_back({key, 1, 0});
+        sift_up(heap.size() - 1);
+    }
+    else {
+        // the newcomer inherits the smallest counter, its old count becomes the error
+        index.erase(heap[0].key);
+        heap[0] = {key, heap[0].count + 1, heap[0].count};
+        sift_down(0);
+        evictions++;
+    }
+}
+
+template <typename KeyType>
+uint64_t SpaceSaving<KeyType>::size() const {
+    return heap.size();
+}
+
+template <typename KeyType>
+uint64_t SpaceSaving<KeyType>::get_capacity() const {
+    return capacity;
+}
+
+// upper bound on the count of any unmonitored symbol
+template <typename KeyType>
+uint64_t SpaceSaving<KeyType>::get_min_count() const {
+    return exact() ? 0 : heap[0].count;
+}
+
+template <typename KeyType>
+uint64_t SpaceSaving<KeyType>::count_occurrence() const {
+    return occurrence;
+}
+
+// nothing was evicted, every count is exact
+template <typename KeyType>
+bool SpaceSaving<KeyType>::exact() const {
+    return evictions == 0;
+}
+
+template <typename KeyType>
+const std::vector<typename SpaceSaving<KeyType>::Counter> & SpaceSaving<KeyType>::get_counters() const {
+    return heap;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef __VITTER_TREE_H__
+#define __VITTER_TREE_H__
+
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Vitter's Algorithm Lambda on arrays. Nodes are stored in implicit numbering
+// from the root down: index 0 is the root and the k-th internal node in index
+// order has its children at 2k+1 and 2k+2, so the shape of the tree is the
+// sequence of node types alone. Weights never increase with the index, and
+// within a weight the internal nodes come first, i.e. leaves precede internal
+// nodes in Vitter's numbering. A block is a run of one weight and one type.
+// Nodes of a block are interchangeable, so sliding a node past a whole block
+// only rewrites the two ends of the range. Parents are found with a Fenwick
+// tree over the node types.
+template <typename KeyType, typename ValueType>
+class VitterTree {
+    std::vector<ValueType> weight;
+    std::vector<uint8_t> internal;
+    std::vector<KeyType> symbol;
+    std::vector<uint64_t> fenwick;
+    std::unordered_map<KeyType, uint64_t> rep;
+    uint64_t nnodes;
+    uint64_t nmoves;
+
+    void set_internal(uint64_t idx, bool val) {
+        if (internal[idx] == val) return;
+
+        internal[idx] = val;
+
+        for (uint64_t i = idx + 1; i < fenwick.size(); i += i & -i) {
+            fenwick[i] += val ? 1 : -1;
+        }
+    }
+
+    // index of the k-th internal node, counting from 0
+    uint64_t select(uint64_t k) const {
+        uint64_t pos = 0;
+
+        for (uint64_t step = std::bit_floor(fenwick.size() - 1); step; step >>= 1) {
+            if (pos + step < fenwick.size() && fenwick[pos + step] <= k) {
+                pos += step;
+                k -= fenwick[pos];
+            }
+        }
+
+        return pos;
+    }
+
+    // (weight, type) of j is above that of idx
+    bool ranks_above(uint64_t j, uint64_t idx) const {
+        return weight[j] > weight[idx] || (weight[j] == weight[idx] && internal[j] > internal[idx]);
+    }
+
+    // highest numbered node of the block of idx, i.e. its lowest index
+    uint64_t leader(uint64_t idx) const {
+        uint64_t lo = 0;
+        uint64_t hi = idx;
+
+        while (lo < hi) {
+            uint64_t mid = (lo + hi) / 2;
+
+            if (ranks_above(mid, idx)) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+
+        return lo;
+    }
+
+    void place_leaf(uint64_t idx, KeyType alpha) {
+        symbol[idx] = alpha;
+        rep[alpha] = idx;
+    }
+
+    // p is the leader of its block. It slides past the next block when that block
+    // holds internal nodes of its weight (p a leaf) or leaves of weight + 1 (p
+    // internal), then the node whose weight changes next is returned.
+    uint64_t slide_and_increment(uint64_t p) {
+        assert(p == leader(p));
+
+        if (p == 0) {
+            weight[0]++;
+            return nnodes;
+        }
+
+        const ValueType wt = weight[p];
+        const uint64_t last = p - 1;
+        const uint64_t first = leader(last);
+
+        if (!internal[p] && internal[last] && weight[last] == wt) {
+            // internal nodes keep their rank, so their subtrees follow them down
+            set_internal(p, true);
+            set_internal(first, false);
+            place_leaf(first, symbol[p]);
+            weight[first] = wt + 1;
+            nmoves++;
+
+            return get_parent(first);
+        }
+
+        if (internal[p] && !internal[last] && weight[last] == wt + 1) {
+            const uint64_t former_parent = get_parent(p);
+
+            // the top leaf of the block takes p's place, p keeps its rank and children
+            set_internal(first, true);
+            set_internal(p, false);
+            place_leaf(p, symbol[first]);
+            weight[p] = wt + 1;
+            nmoves++;
+
+            return former_parent;
+        }
+
+        weight[p]++;
+
+        return get_parent(p);
+    }
+
+public:
+    // capacity is the most nodes the tree will ever hold
+    VitterTree(uint64_t capacity) :
+    weight(capacity, 0), internal(capacity, 0), symbol(capacity, 0), fenwick(capacity + 1, 0), nnodes(1), nmoves(0) {}
+
+    bool contains(KeyType alpha) const {
+        return rep.find(alpha) != rep.end();
+    }
+
+    uint64_t get_parent(uint64_t idx) const {
+        return select((idx - 1) / 2);
+    }
+
+    uint64_t get_depth(uint64_t idx) const {
+        uint64_t depth = 0;
+
+        for (; idx; idx = get_parent(idx)) {
+            depth++;
+        }
+
+        return depth;
+    }
+
+    uint64_t get_code_length(KeyType alpha) const {
+        return get_depth(rep.at(alpha));
+    }
+
+    // the 0-node is always the last node
+    uint64_t get_NTY_code_length() const {
+        return get_depth(nnodes - 1);
+    }
+
+    void update(KeyType alpha) {
+        auto it = rep.find(alpha);
+        uint64_t leaf_to_increment = nnodes + 2;
+        uint64_t q;
+
+        if (it == rep.end()) {
+            // the 0-node becomes an internal 0-node over the new leaf and a new 0-node
+            q = nnodes - 1;
+            set_internal(q, true);
+            place_leaf(nnodes, alpha);
+            weight[nnodes] = weight[nnodes + 1] = 0;
+            leaf_to_increment = nnodes;
+            nnodes += 2;
+        }
+        else {
+            q = it->second;
+
+            uint64_t top = leader(q);
+
+            if (top != q) {
+                KeyType other = symbol[top];
+
+                place_leaf(top, alpha);
+                place_leaf(q, other);
+                q = top;
+                nmoves++;
+            }
+
+            // the 0-node's sibling is incremented last, after its parent
+            if (q == nnodes - 2) {
+                leaf_to_increment = q;
+                q = get_parent(q);
+            }
+        }
+
+        while (q != nnodes) {
+            q = slide_and_increment(q);
+        }
+
+        if (leaf_to_increment < nnodes) {
+            slide_and_increment(leaf_to_increment);
+        }
+    }
+
+    uint64_t size() const {
+        return nnodes;
+    }
+
+    uint64_t count_moves() const {
+        return nmoves;
+    }
+
+    // every internal weight is the sum of its children, and (weight, type) never rises with the index
+    bool check() const {
+        for (uint64_t i = 0, k = 0; i < nnodes; i++) {
+            if (i && ranks_above(i, i - 1)) return false;
+
+            if (internal[i]) {
+                if (weight[i] != weight[2*k + 1] + weight[2*k + 2]) return false;
+                k++;
+            }
+        }
+
+        return true;
+    }
+};
+
+#endif
@@ -1,8 +1,13 @@
+#include <bit>
+#include <chrono>
 #include <cstdint>
 #include <cmath>
-#include <fstream>
+#include <cstring>
 #include <iostream>
+#include <numeric>
+#include <span>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #ifdef _OPENMP
@@ -10,9 +15,17 @@
 #endif
 
 #include "AdaptiveHuffman.h"
+#include "BlockHuffman.h"
+#include "ChunkIndex.h"
 #include "ExtendedHuffman.h"
 #include "Huffman.h"
+#include "MappedFile.h"
+#include "MergeSort.h"
+#include "MultiWidthHistogram.h"
 #include "Node.h"
+#include "RadixSort.h"
+#include "SketchHuffman.h"
+#include "SortFrequency.h"
 
 #ifdef PLOT
 #include "matplotlibcpp.h"
@@ -26,10 +39,14 @@ void print_header(std::string info) {
     std::cout << std::string(info.size() + 4, '*') << std::endl;
 }
 
+// statistics come from the chunk index instead of a rescan of buf
 template <typename KeyType=uint64_t, typename ValueType=uint64_t>
-void whole_data_experiment(const std::vector<uint8_t> &buf, uint64_t bit_width) {
+void whole_data_experiment(std::span<const uint8_t> buf, ChunkIndex<KeyType, ValueType> &index) {
+    uint64_t bit_width = index.get_stride();
+
     print_header(std::to_string(bit_width) + "-bit data source");
-    Huffman<KeyType, ValueType, true, true> huf{buf, bit_width};
+    Huffman<KeyType, ValueType, true, true> huf{index.whole(), bit_width};
+    huf.encode(buf);
     huf.dump();
     std::cout << std::endl;
 
@@ -54,8 +71,11 @@ void whole_data_experiment(const std::vector<uint8_t> &buf, uint64_t bit_width)
     #endif
 }
 
+// a window of whole chunks is a merge of chunk histograms, any other window is counted from the buffer
 template <typename KeyType=uint64_t, typename ValueType=uint64_t>
-void n_bit_experiment(const std::vector<uint8_t> &buf, uint64_t bit_width, uint64_t data_byte) {
+void n_bit_experiment(std::span<const uint8_t> buf, ChunkIndex<KeyType, ValueType> &index, uint64_t data_byte) {
+    uint64_t bit_width = index.get_stride();
+
     #ifdef PLOT
     plt::clf();
     plt::figure_size(640, 480);
@@ -63,12 +83,16 @@ void n_bit_experiment(const std::vector<uint8_t> &buf, uint64_t bit_width, uint6
     plt::ylabel("Probability");
     plt::title("PMFs of " + std::to_string(bit_width) + "-Bit Data Source (" + std::to_string(data_byte) + "MB)");
     #endif
-    for (uint64_t i = 0; i < buf.size(); i += data_byte * 1024 * 1024) {
+    const uint64_t window = data_byte * 1024 * 1024;
+    const bool aligned = window % index.get_chunk_size() == 0;
+
+    for (uint64_t i = 0; i < buf.size(); i += window) {
         uint64_t start_MB = i / (1024 * 1024);
         uint64_t end_MB = std::min(start_MB + data_byte, buf.size() / 1024 / 1024);
 
         print_header(std::to_string(bit_width) + "-bit data source " + std::to_string(start_MB) + "MB-" + std::to_string(end_MB) + "MB");
-        Huffman<KeyType, ValueType, true, true> huf{{buf.begin() + i, buf.begin() + std::min(i + data_byte*1024*1024, buf.size())}, bit_width};
+        Huffman<KeyType, ValueType, true, true> huf = aligned ? Huffman<KeyType, ValueType, true, true>{index.window(i, window), bit_width}
+                                                              : Huffman<KeyType, ValueType, true, true>{buf.subspan(i, std::min(window, buf.size() - i)), bit_width};
         huf.dump();
         std::cout << std::endl;
 
@@ -90,55 +114,450 @@ void n_bit_experiment(const std::vector<uint8_t> &buf, uint64_t bit_width, uint6
     #endif
 }
 
+template <typename KeyType, bool word_read>
+double symbol_extraction_throughput(std::span<const uint8_t> buf, uint64_t bit_width) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    AlphabetStream<KeyType, word_read> data{buf, bit_width};
+    KeyType checksum = 0;
+
+    while (!data.empty()) {
+        checksum ^= data.next();
+    }
+
+    std::chrono::duration<double> elapsed_time = std::chrono::high_resolution_clock::now() - start_time;
+
+    // keeps the loop from being optimized away
+    if (checksum == KeyType{1} << 127) std::cout << std::endl;
+
+    return buf.size() / (1024.0 * 1024.0) / elapsed_time.count();
+}
+
 template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
-void speed_test(const std::vector<uint8_t> &buf) {
+void speed_test(std::span<const uint8_t> buf) {
     constexpr uint64_t nbit = 64;
 
     std::vector<int> x(nbit, 0);
     std::vector<double> noopt_len(nbit, 0);
     std::vector<double> opt_len(nbit, 0);
+    std::vector<double> inplace_len(nbit, 0);
     std::vector<double> noopt_time(nbit, 0);
     std::vector<double> opt_time(nbit, 0);
+    std::vector<double> inplace_time(nbit, 0);
+    std::vector<double> noopt_decode(nbit, 0);
+    std::vector<double> opt_decode(nbit, 0);
+    std::vector<double> inplace_decode(nbit, 0);
+    std::vector<std::vector<bool>> round_trip(nbit);
+    std::vector<double> bitwise_read(nbit, 0);
+    std::vector<double> word_read(nbit, 0);
 
     for (uint64_t i = 1; i <= nbit; i++) {
         Huffman<KeyType, ValueType, false, false> noopt_huf{buf, i};
         Huffman<KeyType, ValueType, true, true> opt_huf{buf, i};
+        Huffman<KeyType, ValueType, true, true, true> inplace_huf{buf, i};
 
         noopt_len[i - 1] = noopt_huf.get_expected_codeword_length();
         opt_len[i - 1] = opt_huf.get_expected_codeword_length();
+        inplace_len[i - 1] = inplace_huf.get_expected_codeword_length();
         noopt_time[i - 1] = noopt_huf.get_execution_time();
         opt_time[i - 1] = opt_huf.get_execution_time();
+        inplace_time[i - 1] = inplace_huf.get_execution_time();
         x[i - 1] = i;
+
+        std::vector<uint8_t> noopt_out = noopt_huf.decode(noopt_huf.encode(buf), buf.size());
+        std::vector<uint8_t> opt_out = opt_huf.decode(opt_huf.encode(buf), buf.size());
+        std::vector<uint8_t> inplace_out = inplace_huf.decode(inplace_huf.encode(buf), buf.size());
+
+        for (auto *out : {&noopt_out, &opt_out, &inplace_out}) {
+            round_trip[i - 1].push_back(std::equal(out->begin(), out->end(), buf.begin(), buf.end()));
+        }
+
+        noopt_decode[i - 1] = noopt_huf.get_decode_throughput();
+        opt_decode[i - 1] = opt_huf.get_decode_throughput();
+        inplace_decode[i - 1] = inplace_huf.get_decode_throughput();
+
+        bitwise_read[i - 1] = symbol_extraction_throughput<KeyType, false>(buf, i);
+        word_read[i - 1] = symbol_extraction_throughput<KeyType, true>(buf, i);
+    }
+
+    // the optimized sweep again, every table from one MultiWidthHistogram
+    using FreqType = SortFrequency<KeyType, ValueType>;
+
+    std::vector<double> sweep_len(nbit, 0);
+    std::vector<uint64_t> widths(nbit);
+    std::iota(widths.begin(), widths.end(), 1);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    MultiWidthHistogram<KeyType, ValueType, FreqType> hist{buf, widths};
+
+    hist.for_each([&](uint64_t i, FreqType &&freq) {
+        Huffman<KeyType, ValueType, true, true, false, FreqType> huf{std::move(freq), i};
+        sweep_len[i - 1] = huf.get_expected_codeword_length();
+    });
+
+    std::chrono::duration<double> sweep_time = std::chrono::high_resolution_clock::now() - start_time;
+    uint64_t mismatches = 0;
+
+    for (uint64_t i = 0; i < nbit; i++) {
+        mismatches += std::abs(sweep_len[i] - opt_len[i]) > 1e-9;
     }
 
-    print_header("Huffman Speed Test: Naive vs Optimized");
+    print_header("Huffman Speed Test: Naive vs Optimized vs In-Place");
 
     for (uint64_t i = 0; i < nbit; i++) {
         if (std::to_string(i + 1).size() == 1) {
-            std::printf("Symbol Length = %lu               Naive       Optimized\n", i + 1);
+            std::printf("Symbol Length = %lu               Naive       Optimized   In-Place\n", i + 1);
         }
         else {
-            std::printf("Symbol Length = %lu              Naive       Optimized\n", i + 1);
+            std::printf("Symbol Length = %lu              Naive       Optimized   In-Place\n", i + 1);
         }
-        std::printf("Expected Codeword Length (bit)  %.6f    %.6f\n", noopt_len[i], opt_len[i]);
-        std::printf("Execution Time (second)         %.6f    %.6f\n", noopt_time[i], opt_time[i]);
+        std::printf("Expected Codeword Length (bit)  %.6f    %.6f    %.6f\n", noopt_len[i], opt_len[i], inplace_len[i]);
+        std::printf("Execution Time (second)         %.6f    %.6f    %.6f\n", noopt_time[i], opt_time[i], inplace_time[i]);
+        std::printf("Decode Throughput (MB/s)        %.6f    %.6f    %.6f\n", noopt_decode[i], opt_decode[i], inplace_decode[i]);
+        std::printf("Round Trip                      %-12s%-12s%s\n", round_trip[i][0] ? "Yes" : "No", round_trip[i][1] ? "Yes" : "No", round_trip[i][2] ? "Yes" : "No");
         std::printf("\n");
     }
 
+    print_header("Symbol Extraction Throughput: Bitwise vs Word-at-a-Time");
+
+    for (uint64_t i = 0; i < nbit; i++) {
+        if (std::to_string(i + 1).size() == 1) {
+            std::printf("Symbol Length = %lu               Bitwise     Word\n", i + 1);
+        }
+        else {
+            std::printf("Symbol Length = %lu              Bitwise     Word\n", i + 1);
+        }
+        std::printf("Throughput (MB/s)               %.6f    %.6f\n", bitwise_read[i], word_read[i]);
+        std::printf("\n");
+    }
+
+    print_header("Width Sweep 1~64: Per-Width Counting vs Single-Pass Histogram");
+    std::printf("                                Per-Width   Single-Pass\n");
+    std::printf("Sweep Time (second)             %-12.6f%.6f\n", std::accumulate(opt_time.begin(), opt_time.end(), 0.0), sweep_time.count());
+    std::printf("Passes over the Input           %-12lu%lu\n", nbit, hist.count_passes());
+    std::printf("Derived Widths                  %-12d%lu\n", 0, hist.count_derived());
+    std::printf("Expected Length Mismatches      %lu\n", mismatches);
+    std::printf("\n");
+
     #ifdef PLOT
     plt::clf();
     plt::figure_size(640, 480);
     plt::named_plot("Naive", x, noopt_time);
     plt::named_plot("Optimized", x, opt_time);
+    plt::named_plot("In-Place", x, inplace_time);
     plt::xlabel("Symbol Length (bit)");
     plt::ylabel("Execution Time (s)");
     plt::legend();
-    plt::title("Huffman Speed Test: Naive vs Optimized");
+    plt::title("Huffman Speed Test: Naive vs Optimized vs In-Place");
     plt::save(IMAGE_PATH "speed_test");
+
+    plt::clf();
+    plt::figure_size(640, 480);
+    plt::named_plot("Naive", x, noopt_decode);
+    plt::named_plot("Optimized", x, opt_decode);
+    plt::named_plot("In-Place", x, inplace_decode);
+    plt::xlabel("Symbol Length (bit)");
+    plt::ylabel("Decode Throughput (MB/s)");
+    plt::legend();
+    plt::title("Huffman Decode Throughput");
+    plt::save(IMAGE_PATH "decode_speed_test");
+
+    plt::clf();
+    plt::figure_size(640, 480);
+    plt::named_plot("Bitwise", x, bitwise_read);
+    plt::named_plot("Word-at-a-Time", x, word_read);
+    plt::xlabel("Symbol Length (bit)");
+    plt::ylabel("Throughput (MB/s)");
+    plt::legend();
+    plt::title("Symbol Extraction Throughput");
+    plt::save(IMAGE_PATH "symbol_extraction_test");
+    #endif
+}
+
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void length_limit_experiment(std::span<const uint8_t> buf) {
+    for (uint64_t bit_width : {8, 16, 32}) {
+        for (uint64_t max_code_length : {0, 24, 20, 16, 12, 11}) {
+            Huffman<KeyType, ValueType, true, true, true> huf{buf, bit_width, max_code_length};
+
+            // limits below ceil(log2(#symbols)) are raised by limit_code_lengths, those rows would be mislabelled
+            if (max_code_length && huf.get_max_codeword_length() > max_code_length) {
+                std::cout << bit_width << "-bit data source: max codeword length " << max_code_length << " skipped, "
+                          << (uint64_t)huf.get_nonzeros() << " symbols need " << huf.get_max_codeword_length() << " (bit)" << std::endl << std::endl;
+                continue;
+            }
+
+            print_header(std::to_string(bit_width) + "-bit data source, max codeword length " + (max_code_length ? std::to_string(max_code_length) : "unlimited"));
+            huf.decode(huf.encode(buf), buf.size(), max_code_length ? max_code_length : 11);
+            huf.dump();
+            std::cout << std::endl;
+        }
+    }
+}
+
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void streaming_experiment(const std::string &path, std::span<const uint8_t> buf) {
+    for (uint64_t bit_width : {8, 13, 32, 61}) {
+        ChunkedReader reader{path, bit_width, 1 * 1024 * 1024};
+
+        if (reader.fail()) return;
+
+        Huffman<KeyType, ValueType, true, true> mem_huf{buf, bit_width};
+        Huffman<KeyType, ValueType, true, true> stream_huf{reader};
+
+        if (reader.fail()) {
+            std::cerr << "Read error on " << path << ": " << std::strerror(reader.get_error()) << std::endl;
+            return;
+        }
+
+        bool same = mem_huf.get_occurrence() == stream_huf.get_occurrence() && mem_huf.get_PMF() == stream_huf.get_PMF();
+
+        print_header(std::to_string(bit_width) + "-bit data source, in-memory vs streaming");
+        std::cout << "Chunk Size:               " << reader.get_chunk_size()           << " (byte)"   << std::endl;
+        std::cout << "Identical Counts:         " << (same ? "Yes" : "No")             << std::endl;
+        std::cout << "In-Memory Time:           " << mem_huf.get_execution_time()      << " (second)" << std::endl;
+        std::cout << "Streaming Time:           " << stream_huf.get_execution_time()   << " (second)" << std::endl;
+        std::cout << std::endl;
+    }
+}
+
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void hash_backend_experiment(std::span<const uint8_t> buf) {
+    using FlatFrequency = Frequency<KeyType, ValueType, 10, FlatMap<KeyType, ValueType>>;
+
+    for (uint64_t bit_width : {24, 32, 48, 64}) {
+        Huffman<KeyType, ValueType, true, true, true> map_huf{buf, bit_width};
+        Huffman<KeyType, ValueType, true, true, true, FlatFrequency> flat_huf{buf, bit_width};
+
+        print_header(std::to_string(bit_width) + "-bit data source, std::unordered_map vs FlatMap");
+        std::cout << "Nonzero Symbols:          " << map_huf.get_nonzeros()                                    << std::endl;
+        std::cout << "Identical Counts:         " << (map_huf.get_PMF() == flat_huf.get_PMF() ? "Yes" : "No") << std::endl;
+        std::cout << "std::unordered_map Time:  " << map_huf.get_execution_time()                 << " (second)" << std::endl;
+        std::cout << "FlatMap Time:             " << flat_huf.get_execution_time()                << " (second)" << std::endl;
+        std::cout << std::endl;
+    }
+}
+
+// a small denom switches Frequency to its dense counters early, so the paged array is what gets compared
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void paged_counter_experiment(std::span<const uint8_t> buf) {
+    using HeapFrequency = Frequency<KeyType, ValueType, 1024>;
+    using NoreserveFrequency = Frequency<KeyType, ValueType, 1024, std::unordered_map<KeyType, ValueType>, true>;
+
+    for (uint64_t bit_width : {20, 24, 28}) {
+        Huffman<KeyType, ValueType, false, true, true, HeapFrequency> heap_huf{buf, bit_width};
+        Huffman<KeyType, ValueType, false, true, true, NoreserveFrequency> noreserve_huf{buf, bit_width};
+
+        print_header(std::to_string(bit_width) + "-bit data source, heap pages vs MAP_NORESERVE");
+        std::cout << "Nonzero Symbols:          " << heap_huf.get_nonzeros()                                         << std::endl;
+        std::cout << "Identical Counts:         " << (heap_huf.get_PMF() == noreserve_huf.get_PMF() ? "Yes" : "No") << std::endl;
+        std::cout << "Heap Pages Time:          " << heap_huf.get_execution_time()                 << " (second)" << std::endl;
+        std::cout << "MAP_NORESERVE Time:       " << noreserve_huf.get_execution_time()            << " (second)" << std::endl;
+        std::cout << std::endl;
+    }
+}
+
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void sort_counting_experiment(std::span<const uint8_t> buf) {
+    using FlatFrequency = Frequency<KeyType, ValueType, 10, FlatMap<KeyType, ValueType>>;
+
+    for (uint64_t bit_width : {48, 64, 96, 127}) {
+        Huffman<KeyType, ValueType, true, true, true, FlatFrequency> hash_huf{buf, bit_width};
+        Huffman<KeyType, ValueType, true, true, true, SortFrequency<KeyType, ValueType>> sort_huf{buf, bit_width};
+
+        print_header(std::to_string(bit_width) + "-bit data source, hashing vs radix sort counting");
+        std::cout << "Nonzero Symbols:          " << hash_huf.get_nonzeros()                                    << std::endl;
+        std::cout << "Identical Counts:         " << (hash_huf.get_PMF() == sort_huf.get_PMF() ? "Yes" : "No") << std::endl;
+        std::cout << "Hashing Time:             " << hash_huf.get_execution_time()                 << " (second)" << std::endl;
+        std::cout << "Sorting Time:             " << sort_huf.get_execution_time()                 << " (second)" << std::endl;
+        std::cout << std::endl;
+    }
+}
+
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void block_container_experiment(std::span<const uint8_t> buf) {
+    for (uint64_t bit_width : {8, 16, 32}) {
+        Huffman<KeyType, ValueType, true, true, true> huf{buf, bit_width};
+        uint64_t single_bytes = huf.encode(buf).size();
+
+        for (uint64_t block_size : {1 * 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024}) {
+            BlockHuffman<KeyType, ValueType> blk{bit_width, block_size};
+            std::vector<uint8_t> container = blk.encode(buf);
+
+            std::vector<uint8_t> decoded = blk.decode(container);
+            bool same = std::equal(decoded.begin(), decoded.end(), buf.begin(), buf.end());
+            uint64_t nblocks = BlockHuffman<KeyType, ValueType>::count_blocks(container);
+
+            if (nblocks) {
+                uint64_t last = nblocks - 1;
+                std::vector<uint8_t> slice = blk.decode_block(container, last);
+                same &= std::equal(slice.begin(), slice.end(), buf.begin() + last * blk.get_block_size());
+            }
+
+            print_header(std::to_string(bit_width) + "-bit data source, " + std::to_string(block_size / 1024 / 1024) + "MB independent blocks");
+            blk.dump();
+            std::cout << "Whole-File Payload:       " << single_bytes                                           << " (byte)" << std::endl;
+            std::cout << "Ratio Cost of Blocks:     " << (1.0 * container.size() / single_bytes - 1) * 100    << " (%)"    << std::endl;
+            std::cout << "Round Trip:               " << (same ? "Yes" : "No")                                  << std::endl;
+            std::cout << std::endl;
+        }
+
+        // a block with one distinct symbol is stored with an empty codeword and no length counts
+        BlockHuffman<KeyType, ValueType> small_blk{bit_width, 64 * 1024};
+        std::vector<uint8_t> constant(1 * 1024 * 1024, 0x5a);
+        std::vector<uint8_t> decoded = small_blk.decode(small_blk.encode(constant));
+        bool constant_same = decoded == constant;
+
+        // one zero-filled block between blocks of the data
+        std::vector<uint8_t> mixed(buf.begin(), buf.begin() + std::min<uint64_t>(buf.size(), 3 * small_blk.get_block_size()));
+        std::fill(mixed.begin() + std::min<uint64_t>(mixed.size(), small_blk.get_block_size()), mixed.begin() + std::min<uint64_t>(mixed.size(), 2 * small_blk.get_block_size()), 0);
+        decoded = small_blk.decode(small_blk.encode(mixed));
+        bool mixed_same = decoded == mixed;
+
+        print_header(std::to_string(bit_width) + "-bit data source, single-symbol blocks");
+        std::cout << "Constant Buffer:          " << (constant_same ? "Yes" : "No") << std::endl;
+        std::cout << "Zero-Filled Block:        " << (mixed_same ? "Yes" : "No")    << std::endl;
+        std::cout << std::endl;
+    }
+}
+
+// one stream, serial decoder vs self-synchronizing parallel decoder, from 1 thread up
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void parallel_decode_experiment(std::span<const uint8_t> buf) {
+    uint64_t max_threads = 1;
+
+    #ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+    #endif
+
+    for (uint64_t bit_width : {8, 13, 32}) {
+        Huffman<KeyType, ValueType, true, true, true> huf{buf, bit_width};
+        std::vector<uint8_t> bits = huf.encode(buf);
+
+        huf.decode(bits, buf.size());
+        double serial = huf.get_decode_throughput();
+
+        print_header(std::to_string(bit_width) + "-bit data source, serial vs parallel decoding of one stream");
+        std::cout << "Serial Decode Throughput: " << serial << " (MB/s)" << std::endl;
+        std::cout << std::endl;
+
+        for (uint64_t nthreads = 1; ; nthreads = std::min(2 * nthreads, max_threads)) {
+            #ifdef _OPENMP
+            omp_set_num_threads(nthreads);
+            #endif
+
+            std::vector<uint8_t> decoded = huf.parallel_decode(bits, buf.size());
+            bool same = std::equal(decoded.begin(), decoded.end(), buf.begin(), buf.end());
+
+            std::printf("Threads = %-3lu                   Parallel    Speedup\n", nthreads);
+            std::printf("Decode Throughput (MB/s)        %.6f    %.6f\n", huf.get_decode_throughput(), huf.get_decode_throughput() / serial);
+            std::printf("Round Trip                      %s\n", same ? "Yes" : "No");
+            std::printf("\n");
+
+            if (nthreads == max_threads) break;
+        }
+
+        #ifdef _OPENMP
+        omp_set_num_threads(max_threads);
+        #endif
+    }
+}
+
+template <uint64_t nstreams, typename HuffmanType>
+void interleaved_decode_row(HuffmanType &huf, std::span<const uint8_t> buf, double serial) {
+    std::vector<uint8_t> bits = huf.template encode_interleaved<nstreams>(buf);
+    std::vector<uint8_t> decoded = huf.template decode_interleaved<nstreams>(bits, buf.size());
+    bool same = std::equal(decoded.begin(), decoded.end(), buf.begin(), buf.end());
+
+    std::printf("%-2lu Streams                      %-12lu%-12.6f%-12.6f%s\n", nstreams, bits.size(), huf.get_decode_throughput(), huf.get_decode_throughput() / serial, same ? "Yes" : "No");
+}
+
+// single core: one serial stream vs 2, 4 and 8 interleaved streams with the same code lengths
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void interleaved_decode_experiment(std::span<const uint8_t> buf) {
+    for (uint64_t bit_width : {8, 12, 16}) {
+        Huffman<KeyType, ValueType, true, true, true> huf{buf, bit_width};
+        std::vector<uint8_t> bits = huf.encode(buf);
+
+        std::vector<uint8_t> decoded = huf.decode(bits, buf.size());
+        double serial = huf.get_decode_throughput();
+        bool same = std::equal(decoded.begin(), decoded.end(), buf.begin(), buf.end());
+
+        print_header(std::to_string(bit_width) + "-bit data source, interleaved streams");
+        std::printf("                                Size        MB/s        Speedup     Round Trip\n");
+        std::printf("1  Stream                       %-12lu%-12.6f%-12.6f%s\n", bits.size(), serial, 1.0, same ? "Yes" : "No");
+        interleaved_decode_row<2>(huf, buf, serial);
+        interleaved_decode_row<4>(huf, buf, serial);
+        interleaved_decode_row<8>(huf, buf, serial);
+        std::printf("\n");
+    }
+}
+
+// leaf ordering of the par_build path: MergeSort vs radix sort of (weight, index) pairs
+template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
+void leaf_sort_scaling_experiment(std::span<const uint8_t> buf, uint64_t bit_width=32) {
+    Frequency<KeyType, ValueType> freq{KeyType{1} << bit_width};
+
+    for_each_alphabet<KeyType>(buf, bit_width, [&](KeyType alphabet) {
+        freq.count(alphabet);
+    });
+
+    auto &nonzeros = freq.get_nonzero_elems();
+    std::vector<std::pair<ValueType, uint64_t>> leaves(nonzeros.size());
+
+    for (uint64_t i = 0; i < nonzeros.size(); i++) {
+        leaves[i] = {freq[nonzeros[i]], i};
+    }
+
+    uint64_t weight_bits = std::bit_width((uint64_t)freq.count_occurrence());
+    uint64_t max_threads = 1;
+
+    #ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+    #endif
+
+    print_header(std::to_string(bit_width) + "-bit leaf ordering: MergeSort vs Radix Sort");
+    std::cout << "Leaves:                   " << leaves.size() << std::endl;
+    std::cout << std::endl;
+
+    for (uint64_t nthreads = 1; ; nthreads = std::min(2 * nthreads, max_threads)) {
+        #ifdef _OPENMP
+        omp_set_num_threads(nthreads);
+        #endif
+
+        auto merge_leaves = leaves;
+        auto radix_leaves = leaves;
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        mergesort(merge_leaves, [](const auto &lhs, const auto &rhs) {
+            return lhs.first < rhs.first;
+        });
+        std::chrono::duration<double> merge_time = std::chrono::high_resolution_clock::now() - start_time;
+
+        start_time = std::chrono::high_resolution_clock::now();
+        radix_sort(radix_leaves, weight_bits);
+        std::chrono::duration<double> radix_time = std::chrono::high_resolution_clock::now() - start_time;
+
+        std::printf("Threads = %-3lu                   MergeSort   Radix Sort\n", nthreads);
+        std::printf("Sort Time (second)              %.6f    %.6f\n", merge_time.count(), radix_time.count());
+        std::printf("\n");
+
+        if (nthreads == max_threads) break;
+    }
+
+    #ifdef _OPENMP
+    omp_set_num_threads(max_threads);
     #endif
 }
 
-void width_experiment(const std::vector<uint8_t> &buf) {
+// sketch trades exact counts for a fixed-memory estimate with error bounds. The
+// exact tables of all widths come from one MultiWidthHistogram sweep, so the
+// execution time of each width is the code construction alone.
+template <bool sketch=false>
+void width_experiment(std::span<const uint8_t> buf) {
+    using FreqType = SortFrequency<__uint128_t, uint64_t>;
+    using HuffmanType = std::conditional_t<sketch, SketchHuffman<__uint128_t>, Huffman<__uint128_t, uint64_t, false, true, false, FreqType>>;
     constexpr uint64_t nbit = 127;
     #ifdef PLOT
     std::vector<uint64_t> x(nbit, 0);
@@ -148,12 +567,13 @@ void width_experiment(const std::vector<uint8_t> &buf) {
     std::vector<double> n(nbit, 0);
     std::vector<double> nr(nbit, 0);
     #endif
-    #pragma omp parallel for num_threads(4) schedule(dynamic, 1)
-    for (uint64_t i = 1; i <= nbit; i++) {
-        Huffman<__uint128_t, uint64_t, false, true> huf{buf, i};
-        print_header(std::to_string(i) + "-bit data source");
-        huf.dump();
-        std::cout << std::endl;
+    auto report = [&](HuffmanType &huf, uint64_t i) {
+        #pragma omp critical
+        {
+            print_header(std::to_string(i) + "-bit data source" + (sketch ? " (sketch)" : ""));
+            huf.dump();
+            std::cout << std::endl;
+        }
 
         #ifdef PLOT
         x[i - 1]  = i;
@@ -163,6 +583,31 @@ void width_experiment(const std::vector<uint8_t> &buf) {
         n[i - 1]  = huf.get_nonzeros();
         nr[i - 1] = (double)huf.get_nonzeros() / ((__uint128_t)1 << i);
         #endif
+    };
+
+    if constexpr (sketch) {
+        #pragma omp parallel for num_threads(4) schedule(dynamic, 1)
+        for (uint64_t i = 1; i <= nbit; i++) {
+            HuffmanType huf{buf, i};
+            report(huf, i);
+        }
+    }
+    else {
+        std::vector<uint64_t> widths(nbit);
+        std::iota(widths.begin(), widths.end(), 1);
+
+        MultiWidthHistogram<__uint128_t, uint64_t, FreqType> hist{buf, widths, 4};
+
+        hist.for_each([&](uint64_t i, FreqType &&freq) {
+            HuffmanType huf{std::move(freq), i};
+            report(huf, i);
+        });
+
+        print_header("Width Sweep 1~127: Single-Pass Histogram");
+        std::cout << "Passes:                   " << hist.count_passes()       << std::endl;
+        std::cout << "Derived Widths:           " << hist.count_derived()      << std::endl;
+        std::cout << "Counting Time:            " << hist.get_execution_time() << " (second)" << std::endl;
+        std::cout << std::endl;
     }
     #ifdef PLOT
     plt::clf();
@@ -200,7 +645,7 @@ void width_experiment(const std::vector<uint8_t> &buf) {
     plt::suptitle("Effect of Different Symbol Lengths (__uint128)");
     plt::tight_layout();
 
-    plt::save(IMAGE_PATH "symlen_1_127.png");
+    plt::save(IMAGE_PATH + std::string(sketch ? "symlen_1_127_sketch.png" : "symlen_1_127.png"));
     #endif
 }
 
@@ -226,7 +671,7 @@ void adaptive_huffman_textbook_example() {
 }
 
 template <typename KeyType=uint64_t, typename ValueType=uint64_t>
-void adaptive_huffman_whole_data_experiment(const std::vector<uint8_t> &buf, uint64_t bit_width) {
+void adaptive_huffman_whole_data_experiment(std::span<const uint8_t> buf, uint64_t bit_width) {
     print_header("AdaHuff: " + std::to_string(bit_width) + "-bit data source");
     AdaptiveHuffman<KeyType, ValueType, false, false, true> huf{buf, bit_width, KeyType{1} << bit_width, bit_width};
     huf.dump();
@@ -254,7 +699,7 @@ void adaptive_huffman_whole_data_experiment(const std::vector<uint8_t> &buf, uin
 }
 
 template <typename KeyType=uint64_t, typename ValueType=uint64_t>
-void adaptive_huffman_n_bit_experiment(const std::vector<uint8_t> &buf, uint64_t bit_width, uint64_t data_byte) {
+void adaptive_huffman_n_bit_experiment(std::span<const uint8_t> buf, uint64_t bit_width, uint64_t data_byte) {
     #ifdef PLOT
     plt::clf();
     plt::figure_size(640, 480);
@@ -267,7 +712,7 @@ void adaptive_huffman_n_bit_experiment(const std::vector<uint8_t> &buf, uint64_t
         uint64_t end_MB = std::min(start_MB + data_byte, buf.size() / 1024 / 1024);
 
         print_header("AdaHuff: " + std::to_string(bit_width) + "-bit data source " + std::to_string(start_MB) + "MB-" + std::to_string(end_MB) + "MB");
-        AdaptiveHuffman<KeyType, ValueType, false, false, true> huf{{buf.begin() + i, buf.begin() + std::min(i + data_byte*1024*1024, buf.size())}, bit_width, KeyType{1} << bit_width, bit_width};
+        AdaptiveHuffman<KeyType, ValueType, false, false, true> huf{std::span{buf}.subspan(i, std::min(data_byte*1024*1024, buf.size() - i)), bit_width, KeyType{1} << bit_width, bit_width};
         huf.dump();
         std::cout << std::endl;
 
@@ -290,37 +735,52 @@ void adaptive_huffman_n_bit_experiment(const std::vector<uint8_t> &buf, uint64_t
 }
 
 template <typename KeyType=uint64_t, typename ValueType=uint64_t>
-void adaptive_huffman_speed_test(const std::vector<uint8_t> &buf) {
+void adaptive_huffman_speed_test(std::span<const uint8_t> buf) {
     constexpr uint64_t nbit = 10;
 
     std::vector<int> x(nbit, 0);
     std::vector<double> noopt_len(nbit, 0);
     std::vector<double> opt_len(nbit, 0);
+    std::vector<double> vitter_len(nbit, 0);
     std::vector<double> noopt_time(nbit, 0);
     std::vector<double> opt_time(nbit, 0);
+    std::vector<double> vitter_time(nbit, 0);
+    std::vector<double> opt_update(nbit, 0);
+    std::vector<double> vitter_update(nbit, 0);
+    std::vector<double> opt_moves(nbit, 0);
+    std::vector<double> vitter_moves(nbit, 0);
 
     for (uint64_t i = 1; i <= nbit; i++) {
         AdaptiveHuffman<KeyType, ValueType, false, false, false> noopt_huf{buf, i, KeyType{1} << i, i};
         AdaptiveHuffman<KeyType, ValueType, false, false, true> opt_huf{buf, i, KeyType{1} << i, i};
+        AdaptiveHuffman<KeyType, ValueType, false, false, true, true> vitter_huf{buf, i, KeyType{1} << i, i};
 
         noopt_len[i - 1] = noopt_huf.get_expected_codeword_length();
         opt_len[i - 1] = opt_huf.get_expected_codeword_length();
+        vitter_len[i - 1] = vitter_huf.get_expected_codeword_length();
         noopt_time[i - 1] = noopt_huf.get_execution_time();
         opt_time[i - 1] = opt_huf.get_execution_time();
+        vitter_time[i - 1] = vitter_huf.get_execution_time();
+        opt_update[i - 1] = opt_huf.get_execution_time() / opt_huf.get_occurrence() * 1e9;
+        vitter_update[i - 1] = vitter_huf.get_execution_time() / vitter_huf.get_occurrence() * 1e9;
+        opt_moves[i - 1] = 1.0 * opt_huf.get_moves() / opt_huf.get_occurrence();
+        vitter_moves[i - 1] = 1.0 * vitter_huf.get_moves() / vitter_huf.get_occurrence();
         x[i - 1] = i;
     }
 
-    print_header("Adaptive Huffman Speed Test: Naive vs Optimized");
+    print_header("Adaptive Huffman Speed Test: Naive vs Optimized vs Vitter");
 
     for (uint64_t i = 0; i < nbit; i++) {
         if (std::to_string(i + 1).size() == 1) {
-            std::printf("Symbol Length = %lu               Naive       Optimized\n", i + 1);
+            std::printf("Symbol Length = %lu               Naive       Optimized   Vitter\n", i + 1);
         }
         else {
-            std::printf("Symbol Length = %lu              Naive       Optimized\n", i + 1);
+            std::printf("Symbol Length = %lu              Naive       Optimized   Vitter\n", i + 1);
         }
-        std::printf("Expected Codeword Length (bit)  %.6f    %.6f\n", noopt_len[i], opt_len[i]);
-        std::printf("Execution Time (second)         %.6f    %.6f\n", noopt_time[i], opt_time[i]);
+        std::printf("Expected Codeword Length (bit)  %.6f    %.6f    %.6f\n", noopt_len[i], opt_len[i], vitter_len[i]);
+        std::printf("Execution Time (second)         %.6f    %.6f    %.6f\n", noopt_time[i], opt_time[i], vitter_time[i]);
+        std::printf("Update Cost (ns/symbol)                     %-12.3f%.3f\n", opt_update[i], vitter_update[i]);
+        std::printf("Node Moves per Symbol                       %-12.6f%.6f\n", opt_moves[i], vitter_moves[i]);
         std::printf("\n");
     }
 
@@ -329,16 +789,17 @@ void adaptive_huffman_speed_test(const std::vector<uint8_t> &buf) {
     plt::figure_size(640, 480);
     plt::named_plot("Naive", x, noopt_time);
     plt::named_plot("Optimized", x, opt_time);
+    plt::named_plot("Vitter", x, vitter_time);
     plt::xlabel("Symbol Length (bit)");
     plt::ylabel("Execution Time (s)");
     plt::legend();
-    plt::title("Adaptive Huffman Speed Test: Naive vs Optimized");
+    plt::title("Adaptive Huffman Speed Test: Naive vs Optimized vs Vitter");
     plt::save(IMAGE_PATH "adahuff_speed_test");
     #endif
 }
 
 template <typename KeyType=__uint128_t, typename ValueType=uint64_t>
-void adaptive_huffman_width_experiment(const std::vector<uint8_t> &buf) {
+void adaptive_huffman_width_experiment(std::span<const uint8_t> buf) {
     constexpr uint64_t nbit = 24;
     #ifdef PLOT
     std::vector<uint64_t> x(nbit, 0);
@@ -388,7 +849,47 @@ void adaptive_huffman_width_experiment(const std::vector<uint8_t> &buf) {
     #endif
 }
 
-void extended_huffman(const std::vector<uint8_t> &buf) {
+template <uint64_t extend_size>
+void extended_closed_form_row(std::span<const uint8_t> buf, uint64_t bit_width) {
+    ExtendedHuffman<__uint128_t, __uint128_t, true, true, extend_size> product{buf, bit_width};
+    ExtendedHuffman<__uint128_t, __uint128_t, true, true, extend_size, true> closed{buf, bit_width};
+
+    std::printf("Symbol Width = %-3lu * %lu            Product     Closed-Form\n", bit_width, extend_size);
+    std::printf("Expected Codeword Length (bit)  %-12.6f%.6f\n", product.get_expected_codeword_length(), closed.get_expected_codeword_length());
+    std::printf("Execution Time (second)         %-12.6f%.6f\n", product.get_execution_time(), closed.get_execution_time());
+    std::printf("\n");
+}
+
+// the product table only fits for small alphabets, the closed form never builds it
+void extended_closed_form_experiment(std::span<const uint8_t> buf) {
+    print_header("Extended Huffman: Product Table vs Closed Form");
+    extended_closed_form_row<2>(buf, 8);
+    extended_closed_form_row<3>(buf, 8);
+    extended_closed_form_row<2>(buf, 12);
+}
+
+template <uint64_t extend_size>
+void block_gain_row(std::span<const uint8_t> buf, uint64_t bit_width) {
+    ExtendedHuffman<__uint128_t, __uint128_t, true, true, extend_size, true> iid{buf, bit_width};
+    ExtendedHuffman<__uint128_t, __uint128_t, true, true, extend_size, false, true> blocks{buf, bit_width};
+
+    std::printf("Symbol Width = %-3lu * %lu            I.I.D.      k-Gram\n", bit_width, extend_size);
+    std::printf("Bits per Symbol                 %-12.6f%.6f\n", iid.get_expected_codeword_length() / extend_size, blocks.get_expected_codeword_length() / extend_size);
+    std::printf("Compression Ratio               %-12.6f%.6f\n", iid.get_compression_ratio(), blocks.get_compression_ratio());
+    std::printf("Execution Time (second)         %-12.6f%.6f\n", iid.get_execution_time(), blocks.get_execution_time());
+    std::printf("\n");
+}
+
+// what coding blocks of k symbols gains on the actual data, against the product of marginals
+void block_gain_experiment(std::span<const uint8_t> buf) {
+    print_header("Extended Huffman: I.I.D. Product vs Empirical k-Gram");
+    block_gain_row<2>(buf, 8);
+    block_gain_row<3>(buf, 8);
+    block_gain_row<2>(buf, 16);
+    block_gain_row<2>(buf, 32);
+}
+
+void extended_huffman(std::span<const uint8_t> buf) {
     std::vector<int> x8(3, 0);
     std::vector<double> cr8(3, 0);
     std::vector<int> x16(2, 0);
@@ -426,7 +927,7 @@ void extended_huffman(const std::vector<uint8_t> &buf) {
     cr16[0] = huf1.get_compression_ratio();
     }
     {
-    ExtendedHuffman<__uint128_t, __uint128_t, true, true, 2> huf2{buf, 16};
+    ExtendedHuffman<__uint128_t, __uint128_t, true, true, 2, true> huf2{buf, 16};
     huf2.dump();
     std::cout << std::endl;
     x16[1] = 2;
@@ -441,7 +942,7 @@ void extended_huffman(const std::vector<uint8_t> &buf) {
     cr32[0] = huf1.get_compression_ratio();
     }
     {
-    ExtendedHuffman<__uint128_t, __uint128_t, true, true, 2> huf2{buf, 32};
+    ExtendedHuffman<__uint128_t, __uint128_t, true, true, 2, true> huf2{buf, 32};
     huf2.dump();
     std::cout << std::endl;
     x32[1] = 2;
@@ -462,7 +963,7 @@ void extended_huffman(const std::vector<uint8_t> &buf) {
     #endif
 }
 
-int main() {
+int main(int argc, char **argv) {
     #ifdef _OPENMP
     omp_set_nested(1);
     #endif
@@ -470,37 +971,96 @@ int main() {
     /***********************************************************/
     /* Read data                                               */
     /***********************************************************/
-    std::fstream f{"./alexnet.pth", std::ios::in|std::ios::binary};
+    std::string path = argc > 1 ? argv[1] : "./alexnet.pth";
+    MappedFile f{path};
 
     if (f.fail()) return 1;
 
-    std::vector<uint8_t> buf{std::istreambuf_iterator<char>(f), {}};
+    std::span<const uint8_t> buf = f.span();
+
+    /***********************************************************/
+    /* Per-chunk histograms, counted once for experiments 1~4  */
+    /***********************************************************/
+    {
+    ChunkIndex<uint64_t> index8{buf, 8};
+    ChunkIndex<uint64_t> index32{buf, 32};
 
     /***********************************************************/
     /* 1st Experiment: 8-bit, whole data, basic Huffman        */
     /***********************************************************/
-    whole_data_experiment(buf, 8);
+    whole_data_experiment(buf, index8);
 
     /***********************************************************/
     /* 2nd Experiment: 32-bit, whole data, basic Huffman       */
     /***********************************************************/
-    whole_data_experiment(buf, 32);
+    whole_data_experiment(buf, index32);
 
     /***********************************************************/
     /* 3rd Experiment: 8-bit, 40MB, basic Huffman              */
     /***********************************************************/
-    n_bit_experiment(buf, 8, 40);
+    n_bit_experiment(buf, index8, 40);
 
     /***********************************************************/
     /* 4th Experiment: 32-bit, 40MB, basic Huffman             */
     /***********************************************************/
-    n_bit_experiment(buf, 32, 40);
+    n_bit_experiment(buf, index32, 40);
+    }
 
     /***********************************************************/
     /* 5th Experiment: Speed test of basic Huffman             */
     /***********************************************************/
     speed_test(buf);
 
+    /***********************************************************/
+    /* Length-limited Huffman: ratio loss vs table size        */
+    /***********************************************************/
+    length_limit_experiment(buf);
+
+    /***********************************************************/
+    /* Streaming statistics: same counts in bounded memory     */
+    /***********************************************************/
+    streaming_experiment(path, buf);
+
+    /***********************************************************/
+    /* Frequency backends: node-based vs flat hash table       */
+    /***********************************************************/
+    hash_backend_experiment(buf);
+
+    /***********************************************************/
+    /* Dense counters: heap pages vs one MAP_NORESERVE mapping */
+    /***********************************************************/
+    paged_counter_experiment(buf);
+
+    /***********************************************************/
+    /* Wide strides: hashing vs sort-based counting            */
+    /***********************************************************/
+    sort_counting_experiment(buf);
+
+    /***********************************************************/
+    /* Leaf ordering: MergeSort vs radix sort, 1~N threads     */
+    /***********************************************************/
+    leaf_sort_scaling_experiment(buf);
+
+    /***********************************************************/
+    /* Independent blocks: parallel encode, random access      */
+    /***********************************************************/
+    block_container_experiment(buf);
+
+    /***********************************************************/
+    /* One stream decoded on all threads, 1~N threads          */
+    /***********************************************************/
+    parallel_decode_experiment(buf);
+
+    /***********************************************************/
+    /* Interleaved streams: decode ILP on one core             */
+    /***********************************************************/
+    interleaved_decode_experiment(buf);
+
+    /***********************************************************/
+    /* Quick scan of 1~127 bit with the Space-Saving sketch    */
+    /***********************************************************/
+    width_experiment<true>(buf);
+
     /***********************************************************/
     /* 6th Experiment: 1~127 bit, whole data, basic Huffman    */
     /***********************************************************/
@@ -550,4 +1110,14 @@ int main() {
     /* 15th Experiment: 8, 16, and 32 extended Huffman         */
     /***********************************************************/
     extended_huffman(buf);
+
+    /***********************************************************/
+    /* Extended Huffman without the product table              */
+    /***********************************************************/
+    extended_closed_form_experiment(buf);
+
+    /***********************************************************/
+    /* Extended Huffman on the actual k-symbol blocks          */
+    /***********************************************************/
+    block_gain_experiment(buf);
 }